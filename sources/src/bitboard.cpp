@@ -16,9 +16,25 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "rodent.h"
-#include "magicmoves.h"
 #include <cstdio>
 
+#ifdef USE_AVX2_DISPATCH
+    #include <immintrin.h>
+#endif
+
+constexpr sBitBoardTables cBitBoard::tables;
+
+#ifdef USE_PEXT
+
+    // Attack tables indexed by occupancy bits extracted with BMI2 PEXT
+    // instruction. Relevant occupancy masks are the same as for magics.
+
+    U64 pext_r_db[102400];
+    U64 pext_b_db[5248];
+    U64 *pext_r_attacks[64];
+    U64 *pext_b_attacks[64];
+#endif
+
 void PrintBb(U64 bbTest) {
 
     for (int sq = 0; sq < 64; sq++) {
@@ -31,190 +47,61 @@ void PrintBb(U64 bbTest) {
 
 void cBitBoard::Init() {
 
-#ifdef USE_MAGIC
-    initmagicmoves();
+#ifdef USE_AVX2_DISPATCH
+    use_avx2 = __builtin_cpu_supports("avx2");
 #endif
 
-    // init pawn attacks
-
-    for (int sq = 0; sq < 64; sq++) {
-        p_attacks[WC][sq] = ShiftNE(SqBb(sq)) | ShiftNW(SqBb(sq));
-        p_attacks[BC][sq] = ShiftSE(SqBb(sq)) | ShiftSW(SqBb(sq));
-    }
-
-    // init knight attacks
+#if defined(USE_PEXT)
+    InitPext();
+#elif defined(USE_MAGIC)
+    initmagicmoves();
+#endif
+}
 
-    for (int sq = 0; sq < 64; sq++) {
-        U64 bb_west = ShiftWest(SqBb(sq));
-        U64 bb_east = ShiftEast(SqBb(sq));
-        n_attacks[sq] = (bb_east | bb_west) << 16;
-        n_attacks[sq] |= (bb_east | bb_west) >> 16;
-        bb_west = ShiftWest(bb_west);
-        bb_east = ShiftEast(bb_east);
-        n_attacks[sq] |= (bb_east | bb_west) << 8;
-        n_attacks[sq] |= (bb_east | bb_west) >> 8;
-    }
+#ifdef USE_PEXT
 
-    // init king attacks
+// Slider attacks found by walking the rays, used only to fill the tables
 
-    for (int sq = 0; sq < 64; sq++) {
-        k_attacks[sq] = SqBb(sq);
-        k_attacks[sq] |= ShiftSideways(k_attacks[sq]);
-        k_attacks[sq] |= (ShiftNorth(k_attacks[sq]) | ShiftSouth(k_attacks[sq]));
-    }
+static U64 RayAttacks(int sq, U64 bb_occ, const int dirs[4][2]) {
 
-    // init table of rays between squares
+    U64 result = 0;
 
-    for (int sq1 = 0; sq1 < 64; sq1++) {
-        for (int sq2 = 0; sq2 < 64; sq2++) {
-            bbBetween[sq1][sq2] = GetBetween(sq1, sq2);
+    for (int d = 0; d < 4; d++) {
+        int f = File(sq) + dirs[d][0];
+        int r = Rank(sq) + dirs[d][1];
+        while (f >= 0 && f < 8 && r >= 0 && r < 8) {
+            result |= SqBb(Sq(f, r));
+            if (bb_occ & SqBb(Sq(f, r))) break;
+            f += dirs[d][0];
+            r += dirs[d][1];
         }
     }
-
-}
-
-// from Laser, originally from chessprogramming wiki
-
-U64 cBitBoard::GetBetween(int sq1, int sq2) {
-
-    const U64 m1 = C64(-1);
-    const U64 a2a7 = C64(0x0001010101010100);
-    const U64 b2g7 = C64(0x0040201008040200);
-    const U64 h1b7 = C64(0x0002040810204080); /* Thanks Dustin, g2b7 did not work for c1-a3 */
-    U64 btwn, line, rank, file;
-
-    btwn = (m1 << sq1) ^ (m1 << sq2);
-    file = (sq2 & 7) - (sq1 & 7);
-    rank = ((sq2 | 7) - sq1) >> 3;
-    line = ((file & 7) - 1) & a2a7; /* a2a7 if same file */
-    line += 2 * (((rank & 7) - 1) >> 58); /* b1g1 if same rank */
-    line += (((rank - file) & 15) - 1) & b2g7; /* b2g7 if same diagonal */
-    line += (((rank + file) & 15) - 1) & h1b7; /* h1b7 if same antidiag */
-    line *= btwn & -btwn; /* mul acts like shift by smaller square */
-    return line & btwn;   /* return the bits on that line in-between */
+    return result;
 }
 
-#if defined(__GNUC__)
+void cBitBoard::InitPext() {
 
-#if defined(__SSSE3__) && !defined(__POPCNT__) // only for ssse3 targets
-    #include "popcnt_ssse3.h"
-    #define popcnt_gcc(x) popcnt_ssse3(x)
-#else
-    #define popcnt_gcc(x) __builtin_popcountll(x)
-#endif
-
-int cBitBoard::PopCnt(U64 bb) {
-    return popcnt_gcc(bb);
-}
+    const int r_dirs[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+    const int b_dirs[4][2] = { {1, 1}, {-1, 1}, {1, -1}, {-1, -1} };
+    U64 *r_ptr = pext_r_db;
+    U64 *b_ptr = pext_b_db;
 
-#elif defined(USE_MM_POPCNT)
-    #include <nmmintrin.h>
-    #ifndef _M_AMD64 // 32 bit windows
-        int cBitBoard::PopCnt(U64 bb) {
-            return _mm_popcnt_u32((unsigned int)(bb >> 32)) + _mm_popcnt_u32((unsigned int)(bb));
-        }
-    #else            // 64 bit windows
-        int cBitBoard::PopCnt(U64 bb) {
-            return (int)_mm_popcnt_u64(bb);
-        }
-    #endif
-#else
+    for (int sq = 0; sq < 64; sq++) {
 
-int cBitBoard::PopCnt(U64 bb) { // general purpose population count
+        // _pdep_u64 spreads consecutive numbers over all subsets of a mask
 
-    U64 k1 = (U64)0x5555555555555555;
-    U64 k2 = (U64)0x3333333333333333;
-    U64 k3 = (U64)0x0F0F0F0F0F0F0F0F;
-    U64 k4 = (U64)0x0101010101010101;
+        pext_r_attacks[sq] = r_ptr;
+        for (U64 i = 0; i < (C64(1) << PopCnt(magicmoves_r_mask[sq])); i++)
+            *r_ptr++ = RayAttacks(sq, _pdep_u64(i, magicmoves_r_mask[sq]), r_dirs);
 
-    bb -= (bb >> 1) & k1;
-    bb = (bb & k2) + ((bb >> 2) & k2);
-    bb = (bb + (bb >> 4)) & k3;
-    return (bb * k4) >> 56;
+        pext_b_attacks[sq] = b_ptr;
+        for (U64 i = 0; i < (C64(1) << PopCnt(magicmoves_b_mask[sq])); i++)
+            *b_ptr++ = RayAttacks(sq, _pdep_u64(i, magicmoves_b_mask[sq]), b_dirs);
+    }
 }
 
 #endif
 
-int cBitBoard::PopFirstBit(U64 *bb) {
-
-    U64 bb_local = *bb;
-    *bb &= (*bb - 1);
-    return FirstOne(bb_local);
-}
-
-U64 cBitBoard::FillNorth(U64 bb) {
-    bb |= bb << 8;
-    bb |= bb << 16;
-    bb |= bb << 32;
-    return bb;
-}
-
-U64 cBitBoard::FillSouth(U64 bb) {
-    bb |= bb >> 8;
-    bb |= bb >> 16;
-    bb |= bb >> 32;
-    return bb;
-}
-
-U64 cBitBoard::FillNorthExcl(U64 bb) {
-    return FillNorth(ShiftNorth(bb));
-}
-
-U64 cBitBoard::FillSouthExcl(U64 bb) {
-    return FillSouth(ShiftSouth(bb));
-}
-
-U64 cBitBoard::FillNorthSq(int sq) {
-    return FillNorth(SqBb(sq));
-}
-
-U64 cBitBoard::FillSouthSq(int sq) {
-    return FillSouth(SqBb(sq));
-}
-
-U64 cBitBoard::GetWPControl(U64 bb) {
-    return (ShiftNE(bb) | ShiftNW(bb));
-}
-
-U64 cBitBoard::GetBPControl(U64 bb) {
-    return (ShiftSE(bb) | ShiftSW(bb));
-}
-
-U64 cBitBoard::GetPawnControl(U64 bb, int sd) {
-    if (sd == WC) return GetWPControl(bb);
-    else          return GetBPControl(bb);
-}
-
-U64 cBitBoard::GetDoubleWPControl(U64 bb) {
-    return (ShiftNE(bb) & ShiftNW(bb));
-}
-
-U64 cBitBoard::GetDoubleBPControl(U64 bb) {
-    return (ShiftSE(bb) & ShiftSW(bb));
-}
-
-U64 cBitBoard::GetFrontSpan(U64 bb, int sd) {
-
-    if (sd == WC) return BB.FillNorthExcl(bb);
-    else          return BB.FillSouthExcl(bb);
-}
-
-U64 cBitBoard::ShiftFwd(U64 bb, int sd) {
-
-    if (sd == WC) return ShiftNorth(bb);
-    return ShiftSouth(bb);
-}
-
-U64 cBitBoard::ShiftSideways(U64 bb) {
-    return (ShiftWest(bb) | ShiftEast(bb));
-}
-
-U64 cBitBoard::PawnAttacks(int sd, int sq) {
-    return p_attacks[sd][sq];
-}
-
-#ifndef USE_MAGIC
-
 U64 cBitBoard::FillOcclSouth(U64 bb_start, U64 bb_block) {
 
     bb_start |= bb_block & (bb_start >> 8);
@@ -301,52 +188,84 @@ U64 cBitBoard::FillOcclNW(U64 bb_start, U64 bb_block) {
     return bb_start;
 }
 
+// Attacks of all bishops and all rooks of both sides at once, for the
+// evaluation attack maps: att[side][0] for bishops, att[side][1] for rooks.
+// Rays of different pieces never interfere, as they stop on any occupied
+// square anyway.
+
+void cBitBoard::SliderAttacks(U64 bb_occ, const U64 bb_bish[2], const U64 bb_rook[2], U64 att[2][2]) {
+
+#ifdef USE_AVX2_DISPATCH
+    if (use_avx2) {
+        SliderAttacksAvx2(bb_occ, bb_bish, bb_rook, att);
+        return;
+    }
 #endif
 
-U64 cBitBoard::KnightAttacks(int sq) {
-    return n_attacks[sq];
+    U64 bb_empty = ~bb_occ;
+
+    for (int sd = 0; sd < 2; sd++) {
+        att[sd][0] = bb_bish[sd] ? BishFill(bb_bish[sd], bb_empty) : 0;
+        att[sd][1] = bb_rook[sd] ? RookFill(bb_rook[sd], bb_empty) : 0;
+    }
 }
 
-U64 cBitBoard::RookAttacks(U64 bb_occ, int sq) {
+#ifdef USE_AVX2_DISPATCH
 
-#ifdef USE_MAGIC
-    return Rmagic(sq, bb_occ);
-#else
-    U64 bb_start = SqBb(sq);
-    U64 result = ShiftNorth(FillOcclNorth(bb_start, ~bb_occ))
-                 | ShiftSouth(FillOcclSouth(bb_start, ~bb_occ))
-                 | ShiftEast(FillOcclEast(bb_start, ~bb_occ))
-                 | ShiftWest(FillOcclWest(bb_start, ~bb_occ));
-    return result;
-#endif
+bool cBitBoard::use_avx2 = false;
+
+// Kogge-Stone fills with one direction per 64-bit lane, four fills at once
+// to keep the pipelines busy. Lanes shift left by l or right by r; the
+// unused count is 64, which gives zero. wrap removes squares reached by
+// wrapping around the board edge.
+
+__attribute__((target("avx2")))
+static inline __m256i ShiftLanes(__m256i bb, __m256i l, __m256i r) {
+    return _mm256_or_si256(_mm256_sllv_epi64(bb, l), _mm256_srlv_epi64(bb, r));
 }
 
-U64 cBitBoard::BishAttacks(U64 bb_occ, int sq) {
-#ifdef USE_MAGIC
-    return Bmagic(sq, bb_occ);
-#else
-    U64 bb_start = SqBb(sq);
-    U64 result = ShiftNE(FillOcclNE(bb_start, ~bb_occ))
-                 | ShiftNW(FillOcclNW(bb_start, ~bb_occ))
-                 | ShiftSE(FillOcclSE(bb_start, ~bb_occ))
-                 | ShiftSW(FillOcclSW(bb_start, ~bb_occ));
-    return result;
-#endif
+__attribute__((target("avx2")))
+static inline U64 MergeLanes(__m256i bb) {
+    __m128i bb2 = _mm_or_si128(_mm256_castsi256_si128(bb), _mm256_extracti128_si256(bb, 1));
+    return (U64)_mm_cvtsi128_si64(_mm_or_si128(bb2, _mm_unpackhi_epi64(bb2, bb2)));
 }
 
-U64 cBitBoard::QueenAttacks(U64 bb_occ, int sq) {
+__attribute__((target("avx2")))
+void cBitBoard::SliderAttacksAvx2(U64 bb_occ, const U64 bb_bish[2], const U64 bb_rook[2], U64 att[2][2]) {
 
-#ifdef USE_MAGIC
-    return Rmagic(sq, bb_occ) | Bmagic(sq, bb_occ);
-#else
-    return RookAttacks(bb_occ, sq) | BishAttacks(bb_occ, sq);
-#endif
-}
+    // lanes: north-east, north-west, south-east, south-west / north, south, east, west
 
-U64 cBitBoard::KingAttacks(int sq) {
-    return k_attacks[sq];
+    const __m256i l[2] = { _mm256_setr_epi64x(9, 7, 64, 64), _mm256_setr_epi64x(8, 64, 1, 64) };
+    const __m256i r[2] = { _mm256_setr_epi64x(64, 64, 7, 9), _mm256_setr_epi64x(64, 8, 64, 1) };
+    const __m256i wrap[2] = {
+        _mm256_setr_epi64x((long long)bbNotA, (long long)bbNotH, (long long)bbNotA, (long long)bbNotH),
+        _mm256_setr_epi64x(-1, -1, (long long)bbNotA, (long long)bbNotH)
+    };
+    const __m256i bb_empty = _mm256_set1_epi64x((long long)~bb_occ);
+    __m256i gen[4], pro[4];
+
+    for (int i = 0; i < 4; i++) {
+        gen[i] = _mm256_set1_epi64x((long long)((i & 1) ? bb_rook[i >> 1] : bb_bish[i >> 1]));
+        pro[i] = _mm256_and_si256(bb_empty, wrap[i & 1]);
+    }
+
+    for (int step = 0; step < 3; step++) {
+        for (int i = 0; i < 4; i++) {
+            __m256i sl = _mm256_slli_epi64(l[i & 1], step);
+            __m256i sr = _mm256_slli_epi64(r[i & 1], step);
+            gen[i] = _mm256_or_si256(gen[i], _mm256_and_si256(pro[i], ShiftLanes(gen[i], sl, sr)));
+            pro[i] = _mm256_and_si256(pro[i], ShiftLanes(pro[i], sl, sr));
+        }
+    }
+
+    // one more step onto the first blocker, then merge the four directions
+
+    for (int i = 0; i < 4; i++)
+        att[i >> 1][i & 1] = MergeLanes(_mm256_and_si256(ShiftLanes(gen[i], l[i & 1], r[i & 1]), wrap[i & 1]));
 }
 
+#endif
+
 void cBitBoard::Print(U64 bb) {
 
     for (int sq = 0; sq < 64; sq++) {
@@ -356,3 +275,43 @@ void cBitBoard::Print(U64 bb) {
     }
     printf("\na b c d e f g h\n");
 }
+
+// Speed of slider attack lookups on random occupancies,
+// to compare the backends (magics, PEXT or fills)
+
+void SliderBench(int iterations) {
+
+    const int occ_cnt = 4096;
+    static U64 bb_occ[occ_cnt];
+    U64 state = C64(0x9E3779B97F4A7C15), checksum = 0;
+
+    if (iterations <= 0) iterations = 1000;
+
+    // xorshift generator of random occupancies
+
+    for (int i = 0; i < occ_cnt; i++) {
+        U64 r[2];
+        for (int j = 0; j < 2; j++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            r[j] = state;
+        }
+        bb_occ[i] = r[0] & r[1]; // about a quarter of the board occupied
+    }
+
+    int start = GetMS();
+
+    for (int it = 0; it < iterations; it++)
+        for (int i = 0; i < occ_cnt; i++) {
+            U64 occ = bb_occ[(i + it) & (occ_cnt - 1)];
+            for (int sq = 0; sq < 64; sq++)
+                checksum += BB.RookAttacks(occ, sq) ^ BB.BishAttacks(occ, sq);
+        }
+
+    int elapsed = GetMS() - start;
+    U64 lookups = (U64)iterations * occ_cnt * 64 * 2;
+
+    printf("%" PRIu64 " slider lookups in %d ms, %.1f M/s (checksum %016" PRIx64 ")\n",
+           lookups, elapsed, (double)lookups / ((elapsed + 1) * 1000.0), checksum);
+}
@@ -0,0 +1,265 @@
+/*
+Rodent, a UCI chess playing engine derived from Sungorus 1.4
+Copyright (C) 2009-2011 Pablo Vazquez (Sungorus author)
+Copyright (C) 2011-2017 Pawel Koziol
+
+Rodent is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+Rodent is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program.
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Bitboard primitives, included by rodent.h. They are called from the hottest
+// loops of evaluation and move generation, so they are defined here to be
+// inlined regardless of link time optimisation.
+
+#pragma once
+
+#include "magicmoves.h"
+
+#ifdef USE_PEXT
+    #include <immintrin.h>
+
+    extern U64 *pext_r_attacks[64];
+    extern U64 *pext_b_attacks[64];
+#endif
+
+// AVX2 set-wise slider attacks, chosen at runtime if the cpu has them
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    #define USE_AVX2_DISPATCH
+#endif
+
+#if defined(__GNUC__)
+    #if defined(__SSSE3__) && !defined(__POPCNT__) // only for ssse3 targets
+        #include "popcnt_ssse3.h"
+        #define popcnt_gcc(x) popcnt_ssse3(x)
+    #else
+        #define popcnt_gcc(x) __builtin_popcountll(x)
+    #endif
+#elif defined(USE_MM_POPCNT)
+    #include <nmmintrin.h>
+#endif
+
+// Squares between two squares on a common line, empty if there is no such line
+// (from Laser, originally from chessprogramming wiki)
+
+constexpr U64 GetBetween(int sq1, int sq2) {
+
+    const U64 m1 = C64(-1);
+    const U64 a2a7 = C64(0x0001010101010100);
+    const U64 b2g7 = C64(0x0040201008040200);
+    const U64 h1b7 = C64(0x0002040810204080); /* Thanks Dustin, g2b7 did not work for c1-a3 */
+
+    U64 btwn = (m1 << sq1) ^ (m1 << sq2);
+    U64 file = (sq2 & 7) - (sq1 & 7);
+    U64 rank = ((sq2 | 7) - sq1) >> 3;
+    U64 line = ((file & 7) - 1) & a2a7; /* a2a7 if same file */
+    line += 2 * (((rank & 7) - 1) >> 58); /* b1g1 if same rank */
+    line += (((rank - file) & 15) - 1) & b2g7; /* b2g7 if same diagonal */
+    line += (((rank + file) & 15) - 1) & h1b7; /* h1b7 if same antidiag */
+    line *= btwn & (0 - btwn); /* mul acts like shift by smaller square */
+    return line & btwn;   /* return the bits on that line in-between */
+}
+
+// Tables that don't depend on occupancy are generated at compile time
+
+struct sBitBoardTables {
+    U64 pawn[2][64];
+    U64 knight[64];
+    U64 king[64];
+    U64 between[64][64];
+};
+
+constexpr sBitBoardTables InitBitBoardTables() {
+
+    sBitBoardTables t = {};
+
+    for (int sq = 0; sq < 64; sq++) {
+        U64 bb = SqBb(sq);
+
+        t.pawn[WC][sq] = ShiftNE(bb) | ShiftNW(bb);
+        t.pawn[BC][sq] = ShiftSE(bb) | ShiftSW(bb);
+
+        U64 bb_west = ShiftWest(bb);
+        U64 bb_east = ShiftEast(bb);
+        t.knight[sq] = (bb_east | bb_west) << 16;
+        t.knight[sq] |= (bb_east | bb_west) >> 16;
+        bb_west = ShiftWest(bb_west);
+        bb_east = ShiftEast(bb_east);
+        t.knight[sq] |= (bb_east | bb_west) << 8;
+        t.knight[sq] |= (bb_east | bb_west) >> 8;
+
+        U64 bb_king = bb | ShiftWest(bb) | ShiftEast(bb);
+        t.king[sq] = bb_king | ShiftNorth(bb_king) | ShiftSouth(bb_king);
+
+        for (int sq2 = 0; sq2 < 64; sq2++)
+            t.between[sq][sq2] = GetBetween(sq, sq2);
+    }
+
+    return t;
+}
+
+class cBitBoard {
+  private:
+    static constexpr sBitBoardTables tables = InitBitBoardTables();
+
+    static U64 FillOcclSouth(U64 bb_start, U64 bb_block);
+    static U64 FillOcclNorth(U64 bb_start, U64 bb_block);
+    static U64 FillOcclEast(U64 bb_start, U64 bb_block);
+    static U64 FillOcclWest(U64 bb_start, U64 bb_block);
+    static U64 FillOcclNE(U64 bb_start, U64 bb_block);
+    static U64 FillOcclNW(U64 bb_start, U64 bb_block);
+    static U64 FillOcclSE(U64 bb_start, U64 bb_block);
+    static U64 FillOcclSW(U64 bb_start, U64 bb_block);
+
+    static U64 RookFill(U64 bb_start, U64 bb_empty) {
+        return ShiftNorth(FillOcclNorth(bb_start, bb_empty))
+             | ShiftSouth(FillOcclSouth(bb_start, bb_empty))
+             | ShiftEast(FillOcclEast(bb_start, bb_empty))
+             | ShiftWest(FillOcclWest(bb_start, bb_empty));
+    }
+
+    static U64 BishFill(U64 bb_start, U64 bb_empty) {
+        return ShiftNE(FillOcclNE(bb_start, bb_empty))
+             | ShiftNW(FillOcclNW(bb_start, bb_empty))
+             | ShiftSE(FillOcclSE(bb_start, bb_empty))
+             | ShiftSW(FillOcclSW(bb_start, bb_empty));
+    }
+
+#ifdef USE_AVX2_DISPATCH
+    static bool use_avx2;
+    static void SliderAttacksAvx2(U64 bb_occ, const U64 bb_bish[2], const U64 bb_rook[2], U64 att[2][2]);
+#endif
+
+#ifdef USE_PEXT
+    void InitPext();
+#endif
+
+  public:
+    void Init();
+    void Print(U64 bb);
+
+    static constexpr U64 ShiftFwd(U64 bb, int sd) {
+        return sd == WC ? ShiftNorth(bb) : ShiftSouth(bb);
+    }
+
+    static constexpr U64 ShiftSideways(U64 bb) {
+        return ShiftWest(bb) | ShiftEast(bb);
+    }
+
+    static constexpr U64 GetWPControl(U64 bb) {
+        return ShiftNE(bb) | ShiftNW(bb);
+    }
+
+    static constexpr U64 GetBPControl(U64 bb) {
+        return ShiftSE(bb) | ShiftSW(bb);
+    }
+
+    static constexpr U64 GetPawnControl(U64 bb, int sd) {
+        return sd == WC ? GetWPControl(bb) : GetBPControl(bb);
+    }
+
+    static constexpr U64 GetDoubleWPControl(U64 bb) {
+        return ShiftNE(bb) & ShiftNW(bb);
+    }
+
+    static constexpr U64 GetDoubleBPControl(U64 bb) {
+        return ShiftSE(bb) & ShiftSW(bb);
+    }
+
+    static constexpr U64 GetKnightControl(U64 bb) {
+        return ((ShiftEast(bb) | ShiftWest(bb)) << 16)
+             | ((ShiftEast(bb) | ShiftWest(bb)) >> 16)
+             | ((ShiftEast(ShiftEast(bb)) | ShiftWest(ShiftWest(bb))) << 8)
+             | ((ShiftEast(ShiftEast(bb)) | ShiftWest(ShiftWest(bb))) >> 8);
+    }
+
+    static constexpr U64 FillNorth(U64 bb) {
+        bb |= bb << 8;
+        bb |= bb << 16;
+        bb |= bb << 32;
+        return bb;
+    }
+
+    static constexpr U64 FillSouth(U64 bb) {
+        bb |= bb >> 8;
+        bb |= bb >> 16;
+        bb |= bb >> 32;
+        return bb;
+    }
+
+    static constexpr U64 FillNorthSq(int sq) { return FillNorth(SqBb(sq)); }
+    static constexpr U64 FillSouthSq(int sq) { return FillSouth(SqBb(sq)); }
+    static constexpr U64 FillNorthExcl(U64 bb) { return FillNorth(ShiftNorth(bb)); }
+    static constexpr U64 FillSouthExcl(U64 bb) { return FillSouth(ShiftSouth(bb)); }
+
+    static constexpr U64 GetFrontSpan(U64 bb, int sd) {
+        return sd == WC ? FillNorthExcl(bb) : FillSouthExcl(bb);
+    }
+
+    static int PopCnt(U64 bb) {
+#if defined(__GNUC__)
+        return popcnt_gcc(bb);
+#elif defined(USE_MM_POPCNT)
+    #ifndef _M_AMD64 // 32 bit windows
+        return _mm_popcnt_u32((unsigned int)(bb >> 32)) + _mm_popcnt_u32((unsigned int)(bb));
+    #else            // 64 bit windows
+        return (int)_mm_popcnt_u64(bb);
+    #endif
+#else                // general purpose population count
+        const U64 k1 = (U64)0x5555555555555555;
+        const U64 k2 = (U64)0x3333333333333333;
+        const U64 k3 = (U64)0x0F0F0F0F0F0F0F0F;
+        const U64 k4 = (U64)0x0101010101010101;
+
+        bb -= (bb >> 1) & k1;
+        bb = (bb & k2) + ((bb >> 2) & k2);
+        bb = (bb + (bb >> 4)) & k3;
+        return (bb * k4) >> 56;
+#endif
+    }
+
+    static int PopFirstBit(U64 *bb) {
+        U64 bb_local = *bb;
+        *bb &= (*bb - 1);
+        return FirstOne(bb_local);
+    }
+
+    static constexpr U64 PawnAttacks(int sd, int sq) { return tables.pawn[sd][sq]; }
+    static constexpr U64 KnightAttacks(int sq) { return tables.knight[sq]; }
+    static constexpr U64 KingAttacks(int sq) { return tables.king[sq]; }
+    static constexpr U64 Between(int sq1, int sq2) { return tables.between[sq1][sq2]; }
+
+    U64 RookAttacks(U64 bb_occ, int sq) {
+#if defined(USE_PEXT)
+        return pext_r_attacks[sq][_pext_u64(bb_occ, magicmoves_r_mask[sq])];
+#elif defined(USE_MAGIC)
+        return Rmagic(sq, bb_occ);
+#else
+        return RookFill(SqBb(sq), ~bb_occ);
+#endif
+    }
+
+    U64 BishAttacks(U64 bb_occ, int sq) {
+#if defined(USE_PEXT)
+        return pext_b_attacks[sq][_pext_u64(bb_occ, magicmoves_b_mask[sq])];
+#elif defined(USE_MAGIC)
+        return Bmagic(sq, bb_occ);
+#else
+        return BishFill(SqBb(sq), ~bb_occ);
+#endif
+    }
+
+    U64 QueenAttacks(U64 bb_occ, int sq) {
+        return RookAttacks(bb_occ, sq) | BishAttacks(bb_occ, sq);
+    }
+
+    static void SliderAttacks(U64 bb_occ, const U64 bb_bish[2], const U64 bb_rook[2], U64 att[2][2]);
+};
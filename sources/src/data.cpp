@@ -18,15 +18,12 @@ If not, see <http://www.gnu.org/licenses/>.
 #include "rodent.h"
 
 int max_depth_completed;
-int POS::castle_mask[64];
 
 const int tp_value[7] = { 100, 325, 325, 500, 1000,  0,   0 };
 const int ph_value[7] = {   0,   1,   1,   2,    4,  0,   0 };
 
-U64 POS::zob_piece[12][64];
-U64 POS::zob_castle[16];
-U64 POS::zob_ep[8];
 int move_time;
+int opt_time;
 int move_nodes;
 int search_depth;
 int start_time;
@@ -110,8 +110,10 @@ void cEngine::EvaluatePieces(POS *p, eData *e, int sd) {
 		center_control += BB.PopCnt(bb_control & bb_center);
         if (!(bb_control  & ~e->p_takes[op] & Mask.away[sd])) // we do not attack enemy half of the board
             Add(e, sd, Par.values[N_OWH]);
+#ifndef USE_FILL_ATT_MAPS
         e->all_att[sd] |= BB.KnightAttacks(sq);
         e->ev_att[sd]  |= bb_control;
+#endif
         if (bb_control & n_checks) att += Par.values[N_CHK];// check threats
 
         bb_possible = bb_control & ~e->p_takes[op];         // reachable outposts
@@ -151,8 +153,10 @@ void cEngine::EvaluatePieces(POS *p, eData *e, int sd) {
 
         bb_control = BB.BishAttacks(OccBb(p), sq);          // get control bitboard
 		center_control += BB.PopCnt(bb_control & bb_center);
+#ifndef USE_FILL_ATT_MAPS
         e->all_att[sd] |= bb_control;                       // update attack map
         e->ev_att[sd]  |= bb_control;
+#endif
         if (!(bb_control & Mask.away[sd]))
              Add(e, sd, Par.values[B_OVH]);                 // we do not attack enemy half of the board
         if (bb_control & b_checks) att += Par.values[B_CHK];// check threats
@@ -214,8 +218,10 @@ void cEngine::EvaluatePieces(POS *p, eData *e, int sd) {
         }
 
         bb_control = BB.RookAttacks(OccBb(p), sq);          // get control bitboard
+#ifndef USE_FILL_ATT_MAPS
         e->all_att[sd] |= bb_control;                       // update attack map
         e->ev_att[sd] |= bb_control;
+#endif
 
         if ((bb_control & ~p->cl_bb[sd] & r_checks)
         && p->Queens(sd)) {
@@ -224,7 +230,7 @@ void cEngine::EvaluatePieces(POS *p, eData *e, int sd) {
 
             while (bb_contact) {
                 int contactSq = BB.PopFirstBit(&bb_contact);    // find a potential contact check
-                if (Swap(p, sq, contactSq) >= 0) {              // rook exchanges are also accepted
+                if (SeeGe(p, sq, contactSq, 0)) {               // rook exchanges are also accepted
                     att += Par.values[R_CONTACT];
                     break;
                 }
@@ -303,7 +309,7 @@ void cEngine::EvaluatePieces(POS *p, eData *e, int sd) {
             bb_contact = bb_control & BB.KingAttacks(king_sq);// queen contact checks
             while (bb_contact) {
                 int contactSq = BB.PopFirstBit(&bb_contact);    // find potential contact check square
-                if (Swap(p, sq, contactSq) >= 0) {              // if check doesn't lose material, evaluate
+                if (SeeGe(p, sq, contactSq, 0)) {               // if check doesn't lose material, evaluate
                     att += Par.values[Q_CONTACT];
                     break;
                 }
@@ -685,12 +691,32 @@ int cEngine::Evaluate(POS *p, eData *e) {
     e->two_pawns_take[WC] = BB.GetDoubleWPControl(p->Pawns(WC));
     e->two_pawns_take[BC] = BB.GetDoubleBPControl(p->Pawns(BC));
 
+#ifdef USE_FILL_ATT_MAPS
+
+    // Init attack maps with all knights, bishops and rooks at once
+    // (queens are added in EvaluatePieces())
+
+    U64 bb_bish[2] = { p->Bishops(WC), p->Bishops(BC) };
+    U64 bb_rook[2] = { p->Rooks(WC), p->Rooks(BC) };
+    U64 bb_slider_att[2][2];
+
+    BB.SliderAttacks(OccBb(p), bb_bish, bb_rook, bb_slider_att);
+
+    for (int sd = 0; sd < 2; sd++) {
+        U64 bb_knight = BB.GetKnightControl(p->Knights(sd));
+
+        e->ev_att[sd] = (bb_knight & ~p->cl_bb[sd]) | bb_slider_att[sd][0] | bb_slider_att[sd][1];
+        e->all_att[sd] = e->ev_att[sd] | bb_knight | e->p_takes[sd] | BB.KingAttacks(KingSq(p, sd));
+    }
+#else
+
     // Init or clear attack maps
 
     e->all_att[WC] = e->p_takes[WC] | BB.KingAttacks(KingSq(p, WC));
     e->all_att[BC] = e->p_takes[BC] | BB.KingAttacks(KingSq(p, BC));
     e->ev_att[WC] = 0ULL;
     e->ev_att[BC] = 0ULL;
+#endif
 
     // Run all the evaluation subroutines
 
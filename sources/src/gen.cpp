@@ -414,7 +414,7 @@ bool CanDiscoverCheck(POS *p, U64 bb_checkers, int op, int from) {
 
     while (bb_checkers) {
         int checker = BB.PopFirstBit(&bb_checkers);
-        U64 bb_ray = BB.bbBetween[checker][p->king_sq[op]];
+        U64 bb_ray = BB.Between(checker, p->king_sq[op]);
 
         if (SqBb(from) & bb_ray) {
             if (BB.PopCnt(bb_ray & OccBb(p)) == 1)
@@ -17,23 +17,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include "rodent.h"
 
-void POS::Init() { // static init function
+// Tables generated at compile time still need a definition (until C++17)
 
-    for (int sq = 0; sq < 64; sq++)
-        castle_mask[sq] = 15;
-
-    castle_mask[A1] = 13;
-    castle_mask[E1] = 12;
-    castle_mask[H1] = 14;
-    castle_mask[A8] = 7;
-    castle_mask[E8] = 3;
-    castle_mask[H8] = 11;
-
-    for (int i = 0; i < 12; i++)
-        for (int j = 0; j < 64; j++)
-            zob_piece[i][j] = Random64();
-    for (int i = 0; i < 16; i++)
-        zob_castle[i] = Random64();
-    for (int i = 0; i < 8; i++)
-        zob_ep[i] = Random64();
-}
+constexpr int POS::castle_mask[64];
+constexpr sZobrist POS::zob;
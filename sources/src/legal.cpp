@@ -101,3 +101,21 @@ bool Legal(POS *p, int move) {
 
     return (AttacksFrom(p, fsq) & SqBb(tsq)) != 0;
 }
+
+// Counts leaf nodes of the legal move tree, to verify move generation
+
+U64 Perft(POS *p, int depth) {
+
+    int list[MAX_MOVES];
+    int *end = GenerateQuiet(p, GenerateCaptures(p, list));
+    U64 nodes = 0;
+    UNDO u[1];
+
+    for (int *mv = list; mv < end; mv++) {
+        p->DoMove(*mv, u);
+        if (!Illegal(p))
+            nodes += depth > 1 ? Perft(p, depth - 1) : 1;
+        p->UndoMove(*mv, u);
+    }
+    return nodes;
+}
@@ -30,6 +30,11 @@
 
 #include "magicmoves.h"
 
+#ifdef TABLEGEN
+    #include <cinttypes>
+    #include <cstdio>
+#endif
+
 #ifdef _MSC_VER
 //  #pragma message("MSC compatible compiler detected -- turning off warning 4312, 4146")
     #pragma warning( disable : 4312 )
@@ -133,7 +138,25 @@ const U64 magicmoves_b_mask[64] = {
     C64(0x0028440200000000), C64(0x0050080402000000), C64(0x0020100804020000), C64(0x0040201008040200)
 };
 
-U64 magicmovesbdb[5248];
+#ifdef MAGICMOVES_GEN
+    #include "magic_gen.h"
+#else
+    U64 magicmovesbdb[5248];
+    U64 magicmovesrdb[102400];
+#if defined(USE_COMPACT_MAGIC) || defined(TABLEGEN)
+    uint8_t magicmoves_b_ref[5248];
+    uint8_t magicmoves_r_ref[102400];
+    U64 magicmoves_b_set[MAGICMOVES_B_SETS];
+    U64 magicmoves_r_set[MAGICMOVES_R_SETS];
+    const uint8_t *magicmoves_b_refs[64];
+    const U64 *magicmoves_b_sets[64];
+    const uint8_t *magicmoves_r_refs[64];
+    const U64 *magicmoves_r_sets[64];
+#endif
+#endif
+
+#ifndef USE_COMPACT_MAGIC
+
 const U64 *magicmoves_b_indices[64] = {
     magicmovesbdb + 4992, magicmovesbdb + 2624,  magicmovesbdb + 256,  magicmovesbdb + 896,
     magicmovesbdb + 1280, magicmovesbdb + 1664, magicmovesbdb + 4800, magicmovesbdb + 5120,
@@ -153,7 +176,6 @@ const U64 *magicmoves_b_indices[64] = {
     magicmovesbdb + 1632, magicmovesbdb + 2272, magicmovesbdb + 4896, magicmovesbdb + 5184
 };
 
-U64 magicmovesrdb[102400];
 const U64 *magicmoves_r_indices[64] = {
     magicmovesrdb + 86016, magicmovesrdb + 73728, magicmovesrdb + 36864, magicmovesrdb + 43008,
     magicmovesrdb + 47104, magicmovesrdb + 51200, magicmovesrdb + 77824, magicmovesrdb + 94208,
@@ -173,6 +195,14 @@ const U64 *magicmoves_r_indices[64] = {
     magicmovesrdb + 49152, magicmovesrdb + 55296, magicmovesrdb + 79872, magicmovesrdb + 98304
 };
 
+#endif //USE_COMPACT_MAGIC
+
+#ifdef MAGICMOVES_GEN
+
+void initmagicmoves() {}
+
+#else
+
 U64 initmagicmoves_occ(const int *squares, const int numSquares, const U64 linocc) {
     int i;
     U64 ret = 0;
@@ -252,6 +282,31 @@ U64 initmagicmoves_Bmoves(const int square, const U64 occ) {
     return ret;
 }
 
+#if defined(USE_COMPACT_MAGIC) || defined(TABLEGEN)
+
+//replaces each database entry by a byte index into the distinct attack sets of its square
+
+void initmagicmoves_refs(U64 *const db_indices[64], const U64 *db, const unsigned int *shift,
+                         uint8_t *ref, U64 *set, const uint8_t *refs[64], const U64 *sets[64]) {
+    int sq, i, j;
+    int numsets = 0;
+    for (sq = 0; sq < 64; sq++) {
+        const U64 *moves = db_indices[sq];
+        const int offset = (int)(moves - db);
+        const int first = numsets;
+        refs[sq] = ref + offset;
+        sets[sq] = set + first;
+        for (i = 0; i < (1 << (64 - shift[sq])); i++) {
+            if (!moves[i]) continue; //not reached by any occupancy
+            for (j = first; j < numsets && set[j] != moves[i]; j++);
+            if (j == numsets) set[numsets++] = moves[i];
+            ref[offset + i] = (uint8_t)(j - first);
+        }
+    }
+}
+
+#endif
+
 //used so that the original indices can be left as const so that the compiler can optimize better
 
 #define BmagicNOMASK2(square, occupancy) *(magicmoves_b_indices2[square]+(((occupancy)*magicmoves_b_magics[square])>>magicmoves_b_shift[square]))
@@ -339,4 +394,61 @@ void initmagicmoves() {
             RmagicNOMASK2(i, tempocc) = initmagicmoves_Rmoves(i, tempocc);
         }
     }
+#if defined(USE_COMPACT_MAGIC) || defined(TABLEGEN)
+    initmagicmoves_refs(magicmoves_b_indices2, magicmovesbdb, magicmoves_b_shift,
+                        magicmoves_b_ref, magicmoves_b_set, magicmoves_b_refs, magicmoves_b_sets);
+    initmagicmoves_refs(magicmoves_r_indices2, magicmovesrdb, magicmoves_r_shift,
+                        magicmoves_r_ref, magicmoves_r_set, magicmoves_r_refs, magicmoves_r_sets);
+#endif
+}
+
+#ifdef TABLEGEN
+
+static void writemagicmoves_db(FILE *f, const char *name, const U64 *db, const int size) {
+    fprintf(f, "const U64 %s[%d] = {\n", name, size);
+    for (int i = 0; i < size; i++)
+        fprintf(f, "0x%016" PRIx64 "%s", db[i], i == size - 1 ? "\n" : ((i + 1) % 4 == 0 ? ",\n" : ", "));
+    fprintf(f, "};\n");
+}
+
+static void writemagicmoves_ref(FILE *f, const char *name, const uint8_t *ref, const int size) {
+    fprintf(f, "const uint8_t %s[%d] = {\n", name, size);
+    for (int i = 0; i < size; i++)
+        fprintf(f, "%d%s", ref[i], i == size - 1 ? "\n" : ((i + 1) % 32 == 0 ? ",\n" : ","));
+    fprintf(f, "};\n");
 }
+
+template<typename T> static void writemagicmoves_ptrs(FILE *f, const char *type, const char *name,
+                                                      const char *base_name, const T **ptrs, const T *base) {
+    fprintf(f, "const %s *%s[64] = {\n", type, name);
+    for (int i = 0; i < 64; i++)
+        fprintf(f, "%s + %d%s", base_name, (int)(ptrs[i] - base), i == 63 ? "\n" : ((i + 1) % 4 == 0 ? ",\n" : ", "));
+    fprintf(f, "};\n");
+}
+
+void writemagicmoves(const char *file_name) {
+    FILE *f = fopen(file_name, "w");
+    if (f == NULL) return;
+
+    fprintf(f, "// Magic move databases, generated by `make tablegen` - do not edit\n\n");
+    fprintf(f, "#ifndef USE_COMPACT_MAGIC\n\n");
+    writemagicmoves_db(f, "magicmovesbdb", magicmovesbdb, 5248);
+    fprintf(f, "\n");
+    writemagicmoves_db(f, "magicmovesrdb", magicmovesrdb, 102400);
+    fprintf(f, "\n#else\n\n");
+    writemagicmoves_ref(f, "magicmoves_b_ref", magicmoves_b_ref, 5248);
+    writemagicmoves_db(f, "magicmoves_b_set", magicmoves_b_set, MAGICMOVES_B_SETS);
+    writemagicmoves_ptrs(f, "uint8_t", "magicmoves_b_refs", "magicmoves_b_ref", magicmoves_b_refs, (const uint8_t *)magicmoves_b_ref);
+    writemagicmoves_ptrs(f, "U64", "magicmoves_b_sets", "magicmoves_b_set", magicmoves_b_sets, (const U64 *)magicmoves_b_set);
+    fprintf(f, "\n");
+    writemagicmoves_ref(f, "magicmoves_r_ref", magicmoves_r_ref, 102400);
+    writemagicmoves_db(f, "magicmoves_r_set", magicmoves_r_set, MAGICMOVES_R_SETS);
+    writemagicmoves_ptrs(f, "uint8_t", "magicmoves_r_refs", "magicmoves_r_ref", magicmoves_r_refs, (const uint8_t *)magicmoves_r_ref);
+    writemagicmoves_ptrs(f, "U64", "magicmoves_r_sets", "magicmoves_r_set", magicmoves_r_sets, (const U64 *)magicmoves_r_set);
+    fprintf(f, "\n#endif //USE_COMPACT_MAGIC\n");
+    fclose(f);
+}
+
+#endif //TABLEGEN
+
+#endif //MAGICMOVES_GEN
@@ -50,6 +50,7 @@
 #pragma once
 
 #define USE_INLINING /*the MMINLINE keyword is assumed to be available*/
+//#define USE_COMPACT_MAGIC /*byte references into distinct attack sets, set by `make build-compact`*/
 
 #include <cstdint>
 
@@ -81,6 +82,30 @@ extern const unsigned int magicmoves_r_shift[64];
 #define MINIMAL_B_BITS_SHIFT(square) 55
 #define MINIMAL_R_BITS_SHIFT(square) 52
 
+/*
+ *Compact layout: the magic index selects a byte in a table of 5248 + 102400
+ *bytes, which picks one of the 1428 + 4900 distinct attack sets of the square.
+ *About 155KB instead of 841KB, at the cost of one more dependent load.
+ */
+
+#define MAGICMOVES_B_SETS 1428
+#define MAGICMOVES_R_SETS 4900
+
+extern const uint8_t *magicmoves_b_refs[64];
+extern const U64 *magicmoves_b_sets[64];
+
+extern const uint8_t *magicmoves_r_refs[64];
+extern const U64 *magicmoves_r_sets[64];
+
+#ifdef USE_COMPACT_MAGIC
+
+#ifndef USE_INLINING
+    #define Bmagic(square, occupancy) magicmoves_b_sets[square][magicmoves_b_refs[square][(((occupancy)&magicmoves_b_mask[square])*magicmoves_b_magics[square])>>magicmoves_b_shift[square]]]
+    #define Rmagic(square, occupancy) magicmoves_r_sets[square][magicmoves_r_refs[square][(((occupancy)&magicmoves_r_mask[square])*magicmoves_r_magics[square])>>magicmoves_r_shift[square]]]
+#endif //USE_INLINING
+
+#else //!USE_COMPACT_MAGIC
+
 #ifndef USE_INLINING
     #define Bmagic(square, occupancy) *(magicmoves_b_indices[square]+((((occupancy)&magicmoves_b_mask[square])*magicmoves_b_magics[square])>>magicmoves_b_shift[square]))
     #define Rmagic(square, occupancy) *(magicmoves_r_indices[square]+((((occupancy)&magicmoves_r_mask[square])*magicmoves_r_magics[square])>>magicmoves_r_shift[square]))
@@ -92,13 +117,24 @@ extern const U64 *magicmoves_b_indices[64];
 //extern U64 magicmovesrdb[102400];
 extern const U64 *magicmoves_r_indices[64];
 
+#endif //USE_COMPACT_MAGIC
+
 #ifdef USE_INLINING
+#ifdef USE_COMPACT_MAGIC
+    static MMINLINE U64 Bmagic(const unsigned int square, const U64 occupancy) {
+        return magicmoves_b_sets[square][magicmoves_b_refs[square][((occupancy & magicmoves_b_mask[square]) * magicmoves_b_magics[square]) >> magicmoves_b_shift[square]]];
+    }
+    static MMINLINE U64 Rmagic(const unsigned int square, const U64 occupancy) {
+        return magicmoves_r_sets[square][magicmoves_r_refs[square][((occupancy & magicmoves_r_mask[square]) * magicmoves_r_magics[square]) >> magicmoves_r_shift[square]]];
+    }
+#else
     static MMINLINE U64 Bmagic(const unsigned int square, const U64 occupancy) {
         return *(magicmoves_b_indices[square] + (((occupancy & magicmoves_b_mask[square]) * magicmoves_b_magics[square]) >> magicmoves_b_shift[square]));
     }
     static MMINLINE U64 Rmagic(const unsigned int square, const U64 occupancy) {
         return *(magicmoves_r_indices[square] + (((occupancy & magicmoves_r_mask[square]) * magicmoves_r_magics[square]) >> magicmoves_r_shift[square]));
     }
+#endif //USE_COMPACT_MAGIC
 
     static MMINLINE U64 Qmagic(const unsigned int square, const U64 occupancy) {
         return Bmagic(square, occupancy) | Rmagic(square, occupancy);
@@ -110,4 +146,15 @@ extern const U64 *magicmoves_r_indices[64];
 
 #endif //USE_INLINING
 
+// With USEGEN the databases are compiled in from magic_gen.h (written by
+// `make tablegen`) and initmagicmoves() has nothing left to do
+
+#if defined(USEGEN) && !defined(TABLEGEN)
+    #define MAGICMOVES_GEN
+#endif
+
 void initmagicmoves();
+
+#ifdef TABLEGEN
+    void writemagicmoves(const char *file_name);
+#endif
@@ -18,6 +18,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include "rodent.h"
 #include "book.h"
 #include <cstdlib>
+#include <chrono>
 
 cGlobals Glob;
 
@@ -29,8 +30,6 @@ cGlobals Glob;
 #endif
 cBitBoard BB;
 cParam Par;
-cMask Mask;
-cDistance Dist;
 sBook GuideBook;
 sBook MainBook;
 
@@ -40,6 +39,37 @@ sBook MainBook;
     #include "book_gen.h"
 #endif
 
+// Time taken by the parts of initialisation, shown by `startup` command
+
+static const int max_init_steps = 16;
+static const char *init_step_name[max_init_steps];
+static int init_step_us[max_init_steps];
+static int init_steps = 0;
+
+static void InitStepDone(const char *name) {
+
+    using namespace std::chrono;
+    static steady_clock::time_point last = steady_clock::now();
+
+    steady_clock::time_point now = steady_clock::now();
+    if (init_steps < max_init_steps) {
+        init_step_name[init_steps] = name;
+        init_step_us[init_steps++] = (int)duration_cast<microseconds>(now - last).count();
+    }
+    last = now;
+}
+
+void PrintStartupTimes() {
+
+    int total = 0;
+
+    for (int i = 1; i < init_steps; i++) {
+        printf("%-20s %6d us\n", init_step_name[i], init_step_us[i]);
+        total += init_step_us[i];
+    }
+    printf("%-20s %6d us\n", "total", total);
+}
+
 void PrintVersion()
 {
     printf("id name Rodent III 0.210"
@@ -79,16 +109,21 @@ int main() {
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+    InitStepDone("start");
     srand(GetMS());
 
     BB.Init();
-    cEngine::InitSearch();
-    POS::Init();
+    InitStepDone("bitboards");
+
+#ifdef TABLEGEN
+    writemagicmoves("magic_gen.h");
+    return 0;
+#endif
+
     Glob.Init();
     Par.DefaultWeights();
     Par.InitTables();
-    Mask.Init();
-    Dist.Init();
+    InitStepDone("parameters");
 
     PrintVersion();
 
@@ -108,9 +143,11 @@ int main() {
     // reading default personality
     if (Glob.use_personality_files)
         ReadPersonality("default.txt");
+    InitStepDone("books, personality");
 #endif
 
     InternalBook.Init();
+    InitStepDone("internal book");
 
 #ifndef BOOKGEN
     UciLoop();
@@ -126,6 +163,11 @@ void cGlobals::Init() {
     use_books_from_pers = true;
     show_pers_file = true;
     thread_no = 1;
+    multi_pv = 1;
+    deterministic = false;
+    use_abdada = false;
+    node_budget = false;
+    search_moves_cnt = 0;
 
     // Clearing  and  setting threads  may  be  necessary
     // if we need a compile using a bigger default number
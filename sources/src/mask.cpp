@@ -17,7 +17,12 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include "rodent.h"
 
-void cMask::Init() {
+// Masks are built at compile time; the constructor has to be constexpr
+// so that Mask ends up in read-only data instead of being set up at startup
+
+constexpr cMask::cMask()
+    : k_side(), q_side(), home(), away(), ks_castle(), qs_castle(), outpost_map(),
+      passed(), adjacent(), supported(), wb_special(), bb_special() {
 
     // Kingside/queenside
 
@@ -49,20 +54,20 @@ void cMask::Init() {
     // Supported mask (for weak pawns detection)
 
     for (int sq = 0; sq < 64; sq++) {
-        supported[WC][sq] = BB.ShiftSideways(SqBb(sq));
-        supported[WC][sq] |= BB.FillSouth(supported[WC][sq]);
+        supported[WC][sq] = cBitBoard::ShiftSideways(SqBb(sq));
+        supported[WC][sq] |= cBitBoard::FillSouth(supported[WC][sq]);
 
-        supported[BC][sq] = BB.ShiftSideways(SqBb(sq));
-        supported[BC][sq] |= BB.FillNorth(supported[BC][sq]);
+        supported[BC][sq] = cBitBoard::ShiftSideways(SqBb(sq));
+        supported[BC][sq] |= cBitBoard::FillNorth(supported[BC][sq]);
     }
 
     // Init mask for passed pawn detection
 
     for (int sq = 0; sq < 64; sq++) {
-        passed[WC][sq] = BB.FillNorthExcl(SqBb(sq));
-        passed[WC][sq] |= BB.ShiftSideways(passed[WC][sq]);
-        passed[BC][sq] = BB.FillSouthExcl(SqBb(sq));
-        passed[BC][sq] |= BB.ShiftSideways(passed[BC][sq]);
+        passed[WC][sq] = cBitBoard::FillNorthExcl(SqBb(sq));
+        passed[WC][sq] |= cBitBoard::ShiftSideways(passed[WC][sq]);
+        passed[BC][sq] = cBitBoard::FillSouthExcl(SqBb(sq));
+        passed[BC][sq] |= cBitBoard::ShiftSideways(passed[BC][sq]);
     }
 
     // Mask of squares with positive outpost score
@@ -80,3 +85,5 @@ void cMask::Init() {
     bb_special = SqBb(A2) | SqBb(A3) | SqBb(B1) | SqBb(H2) | SqBb(H3) | SqBb(G1) | SqBb(C8) | SqBb(F8) | SqBb(G7) | SqBb(B7);
 
 }
+
+constexpr cMask Mask;
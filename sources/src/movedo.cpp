@@ -37,25 +37,25 @@ void POS::DoMove(int move, UNDO *u) {
 
     // Update reversible moves counter
 
-    rep_list[head++] = hash_key;
+    head++;
     if (ftp == P || ttp != NO_TP) rev_moves = 0;
     else                          rev_moves++;
 
     // Update pawn hash on pawn or king move
 
     if (ftp == P || ftp == K)
-        pawn_key ^= zob_piece[Pc(sd, ftp)][fsq] ^ zob_piece[Pc(sd, ftp)][tsq];
+        pawn_key ^= zob.piece[Pc(sd, ftp)][fsq] ^ zob.piece[Pc(sd, ftp)][tsq];
 
     // Update castling rights
 
-    hash_key ^= zob_castle[c_flags];
+    hash_key ^= zob.castle[c_flags];
     c_flags &= castle_mask[fsq] & castle_mask[tsq];
-    hash_key ^= zob_castle[c_flags];
+    hash_key ^= zob.castle[c_flags];
 
     // Clear en passant square
 
     if (ep_sq != NO_SQ) {
-        hash_key ^= zob_ep[File(ep_sq)];
+        hash_key ^= zob.ep[File(ep_sq)];
         ep_sq = NO_SQ;
     }
 
@@ -63,7 +63,7 @@ void POS::DoMove(int move, UNDO *u) {
 
     pc[fsq] = NO_PC;
     pc[tsq] = Pc(sd, ftp);
-    hash_key ^= zob_piece[Pc(sd, ftp)][fsq] ^ zob_piece[Pc(sd, ftp)][tsq];
+    hash_key ^= zob.piece[Pc(sd, ftp)][fsq] ^ zob.piece[Pc(sd, ftp)][tsq];
     cl_bb[sd] ^= SqBb(fsq) | SqBb(tsq);
     tp_bb[ftp] ^= SqBb(fsq) | SqBb(tsq);
     mg_sc[sd] += Par.mg_pst[sd][ftp][tsq] - Par.mg_pst[sd][ftp][fsq];
@@ -77,10 +77,10 @@ void POS::DoMove(int move, UNDO *u) {
     // Capture enemy piece
 
     if (ttp != NO_TP) {
-        hash_key ^= zob_piece[Pc(op, ttp)][tsq];
+        hash_key ^= zob.piece[Pc(op, ttp)][tsq];
 
         if (ttp == P)
-            pawn_key ^= zob_piece[Pc(op, ttp)][tsq]; // pawn hash
+            pawn_key ^= zob.piece[Pc(op, ttp)][tsq]; // pawn hash
 
         cl_bb[op] ^= SqBb(tsq);
         tp_bb[ttp] ^= SqBb(tsq);
@@ -109,7 +109,7 @@ void POS::DoMove(int move, UNDO *u) {
 
             pc[fsq] = NO_PC;
             pc[tsq] = Pc(sd, R);
-            hash_key ^= zob_piece[Pc(sd, R)][fsq] ^ zob_piece[Pc(sd, R)][tsq];
+            hash_key ^= zob.piece[Pc(sd, R)][fsq] ^ zob.piece[Pc(sd, R)][tsq];
             cl_bb[sd] ^= SqBb(fsq) | SqBb(tsq);
             tp_bb[R] ^= SqBb(fsq) | SqBb(tsq);
             mg_sc[sd] += Par.mg_pst[sd][R][tsq] - Par.mg_pst[sd][R][fsq];
@@ -121,8 +121,8 @@ void POS::DoMove(int move, UNDO *u) {
         case EP_CAP:
             tsq ^= 8;
             pc[tsq] = NO_PC;
-            hash_key ^= zob_piece[Pc(op, P)][tsq];
-            pawn_key ^= zob_piece[Pc(op, P)][tsq];
+            hash_key ^= zob.piece[Pc(op, P)][tsq];
+            pawn_key ^= zob.piece[Pc(op, P)][tsq];
             cl_bb[op] ^= SqBb(tsq);
             tp_bb[P] ^= SqBb(tsq);
             mg_sc[op] -= Par.mg_pst[op][P][tsq];
@@ -137,7 +137,7 @@ void POS::DoMove(int move, UNDO *u) {
             tsq ^= 8;
             if (BB.PawnAttacks(sd, tsq) & Pawns(op)) {
                 ep_sq = tsq;
-                hash_key ^= zob_ep[File(tsq)];
+                hash_key ^= zob.ep[File(tsq)];
             }
             break;
 
@@ -146,8 +146,8 @@ void POS::DoMove(int move, UNDO *u) {
         case N_PROM: case B_PROM: case R_PROM: case Q_PROM:
             ftp = PromType(move);
             pc[tsq] = Pc(sd, ftp);
-            hash_key ^= zob_piece[Pc(sd, P)][tsq] ^ zob_piece[Pc(sd, ftp)][tsq];
-            pawn_key ^= zob_piece[Pc(sd, P)][tsq];
+            hash_key ^= zob.piece[Pc(sd, P)][tsq] ^ zob.piece[Pc(sd, ftp)][tsq];
+            pawn_key ^= zob.piece[Pc(sd, P)][tsq];
             tp_bb[P] ^= SqBb(tsq);
             tp_bb[ftp] ^= SqBb(tsq);
             mg_sc[sd] += Par.mg_pst[sd][ftp][tsq] - Par.mg_pst[sd][P][tsq];
@@ -168,10 +168,10 @@ void POS::DoNull(UNDO *u) {
 
     u->ep_sq = ep_sq;
     u->hash_key = hash_key;
-    rep_list[head++] = hash_key;
+    head++;
     rev_moves++;
     if (ep_sq != NO_SQ) {
-        hash_key ^= zob_ep[File(ep_sq)];
+        hash_key ^= zob.ep[File(ep_sq)];
         ep_sq = NO_SQ;
     }
     side ^= 1;
@@ -25,8 +25,8 @@ void cEngine::InitMoves(POS *p, MOVES *m, int trans_move, int ref_move, int ref_
     m->trans_move = trans_move;
     m->ref_move = ref_move;
     m->ref_sq = ref_sq;
-    m->killer1 = killer[ply][0];
-    m->killer2 = killer[ply][1];
+    m->killer1 = stack[ply].killer[0];
+    m->killer2 = stack[ply].killer[1];
 }
 
 int cEngine::NextMove(MOVES *m, int *flag) {
@@ -44,14 +44,14 @@ int cEngine::NextMove(MOVES *m, int *flag) {
         // fallthrough
 
         case 1: // helper phase: generate captures
+            m->next = m->move;
             m->last = GenerateCaptures(m->p, m->move);
             ScoreCaptures(m);
-            m->next = m->move;
-            m->badp = m->bad;
+            m->badp = m->move;
             m->phase = 2;
         // fallthrough
 
-        case 2: // return good captures, save bad ones on the separate list
+        case 2: // return good captures, save bad ones at the start of the list
             while (m->next < m->last) {
                 move = SelectBest(m);
                 if (move == m->trans_move)
@@ -101,9 +101,9 @@ int cEngine::NextMove(MOVES *m, int *flag) {
         // fallthrough
 
         case 6: // helper phase: generate quiet moves
-            m->last = GenerateQuiet(m->p, m->move);
+            m->next = m->badp; // keep bad captures
+            m->last = GenerateQuiet(m->p, m->badp);
             ScoreQuiet(m);
-            m->next = m->move;
             m->phase = 7;
         // fallthrough
 
@@ -119,7 +119,7 @@ int cEngine::NextMove(MOVES *m, int *flag) {
                 return move;
             }
 
-            m->next = m->bad;
+            m->next = m->move;
             m->phase = 8;
         // fallthrough
 
@@ -147,10 +147,10 @@ int cEngine::NextSpecialMove(MOVES *m, int *flag) {
         // fallthrough
 
         case 1: // helper phase: generate captures
+            m->next = m->move;
             m->last = GenerateCaptures(m->p, m->move);
             ScoreCaptures(m);
-            m->next = m->move;
-            m->badp = m->bad;
+            m->badp = m->move;
             m->phase = 2;
         // fallthrough
 
@@ -189,9 +189,9 @@ int cEngine::NextSpecialMove(MOVES *m, int *flag) {
         // fallthrough
 
         case 5: // helper phase: generate checking moves
+            m->next = m->move;
             m->last = GenerateSpecial(m->p, m->move);
             ScoreQuiet(m);
-            m->next = m->move;
             m->phase = 6;
         // fallthrough
 
@@ -212,9 +212,9 @@ int cEngine::NextSpecialMove(MOVES *m, int *flag) {
 void cEngine::InitCaptures(POS *p, MOVES *m) {
 
     m->p = p;
+    m->next = m->move;
     m->last = GenerateCaptures(m->p, m->move);
     ScoreCaptures(m);
-    m->next = m->move;
 }
 
 int cEngine::NextCapture(MOVES *m) {
@@ -228,44 +228,51 @@ int cEngine::NextCapture(MOVES *m) {
     return 0;
 }
 
+// Scores are packed above the moves from m->next to m->last,
+// so they must fit in 16 bits
+
 void cEngine::ScoreCaptures(MOVES *m) {
 
-    int *movep, *valuep;
+    int *movep, victim;
+
+    // MVV/LVA still decides the order of victims, but capture history
+    // may promote a less valuable attacker that keeps producing cutoffs
+    // over a more valuable one that fails on a given square
 
-    valuep = m->value;
-    for (movep = m->move; movep < m->last; movep++)
-        *valuep++ = MvvLva(m->p, *movep);
+    for (movep = m->next; movep < m->last; movep++) {
+        int mv_score = MvvLva(m->p, *movep) * 128;
+        if ((victim = CaptVictim(m->p, *movep)) != NO_TP)
+            mv_score += capt_history[m->p->pc[Fsq(*movep)]][Tsq(*movep)][victim] / 128;
+        *movep = PackMove(*movep, mv_score);
+    }
 }
 
 void cEngine::ScoreQuiet(MOVES *m) {
 
-    int *movep, *valuep;
+    int *movep;
 
-    valuep = m->value;
-    for (movep = m->move; movep < m->last; movep++) {
+    for (movep = m->next; movep < m->last; movep++) {
         int mv_score = history[m->p->pc[Fsq(*movep)]][Tsq(*movep)]; // use history score
         if (Fsq(*movep) == m->ref_sq) mv_score += 2048;             // but bump up refutation move
-        *valuep++ = mv_score;
+        *movep = PackMove(*movep, Clip(mv_score, MAX_MOVE_SCORE));
     }
 }
 
+// Bubbles the best entry up to m->next; comparing packed entries
+// compares scores first
+
 int cEngine::SelectBest(MOVES *m) {
 
-    int *movep, *valuep, aux;
+    int *movep, aux;
 
-    valuep = m->value + (m->last - m->move) - 1;
     for (movep = m->last - 1; movep > m->next; movep--) {
-        if (*valuep > *(valuep - 1)) {
-            aux = *valuep;
-            *valuep = *(valuep - 1);
-            *(valuep - 1) = aux;
+        if (*movep > *(movep - 1)) {
             aux = *movep;
             *movep = *(movep - 1);
             *(movep - 1) = aux;
         }
-        valuep--;
     }
-    return *m->next++;
+    return UnpackMove(*m->next++);
 }
 
 int cEngine::BadCapture(POS *p, int move) {
@@ -281,7 +288,7 @@ int cEngine::BadCapture(POS *p, int move) {
     if (MoveType(move) == EP_CAP)
         return 0;
 
-    return Swap(p, fsq, tsq) < 0;
+    return !SeeGe(p, fsq, tsq, 0);
 }
 
 int cEngine::MvvLva(POS *p, int move) {
@@ -301,16 +308,40 @@ void cEngine::AgeHist() {
         for (int sq = 0; sq < 64; sq++)
             history[tp][sq] /= 8;
 
-    ZEROARRAY(killer);
+    for (int tp = 0; tp < 12; tp++)
+        for (int sq = 0; sq < 64; sq++)
+            for (int vc = 0; vc < 6; vc++)
+                capt_history[tp][sq][vc] /= 8;
+
+    ClearKillers();
+}
+
+// Add a little noise to history scores of a helper thread
+
+void cEngine::PerturbHist() {
+
+    for (int tp = 0; tp < 12; tp++)
+        for (int sq = 0; sq < 64; sq++)
+            history[tp][sq] += RandomInt(513) - 256;
 }
 
 void cEngine::ClearHist() {
 
     ZEROARRAY(history);
 
+    ZEROARRAY(capt_history);
+
     ZEROARRAY(refutation);
 
-    ZEROARRAY(killer);
+    ClearKillers();
+}
+
+void cEngine::ClearKillers() {
+
+    for (int ply = 0; ply <= MAX_PLY; ply++) {
+        stack[ply].killer[0] = 0;
+        stack[ply].killer[1] = 0;
+    }
 }
 
 void cEngine::TrimHist() {
@@ -342,9 +373,9 @@ void cEngine::UpdateHistory(POS *p, int last_move, int move, int depth, int ply)
 
     // Update killer moves
 
-    if (move != killer[ply][0]) {
-        killer[ply][1] = killer[ply][0];
-        killer[ply][0] = move;
+    if (move != stack[ply].killer[0]) {
+        stack[ply].killer[1] = stack[ply].killer[0];
+        stack[ply].killer[0] = move;
     }
 }
 
@@ -361,6 +392,168 @@ void cEngine::DecreaseHistory(POS *p, int move, int depth) {
     if (history[p->pc[Fsq(move)]][Tsq(move)] < -MAX_HIST) TrimHist();
 }
 
+int cEngine::CaptVictim(POS *p, int move) {
+
+    // Type of the captured piece, NO_TP for quiet moves and non-capturing promotions
+
+    if (MoveType(move) == EP_CAP) return P;
+    return TpOnSq(p, Tsq(move));
+}
+
+void cEngine::TrimCaptHist() {
+
+    for (int tp = 0; tp < 12; tp++)
+        for (int sq = 0; sq < 64; sq++)
+            for (int vc = 0; vc < 6; vc++)
+                capt_history[tp][sq][vc] /= 2;
+}
+
+void cEngine::UpdateCaptHistory(POS *p, int move, int depth) {
+
+    int victim = CaptVictim(p, move);
+
+    // Only captures are scored here, quiet moves go through UpdateHistory()
+
+    if (victim == NO_TP) return;
+
+    int *entry = &capt_history[p->pc[Fsq(move)]][Tsq(move)][victim];
+    *entry += 2 * depth * depth;
+    if (*entry > MAX_HIST) TrimCaptHist();
+}
+
+void cEngine::DecreaseCaptHistory(POS *p, int move, int depth) {
+
+    int victim = CaptVictim(p, move);
+
+    if (victim == NO_TP) return;
+
+    int *entry = &capt_history[p->pc[Fsq(move)]][Tsq(move)][victim];
+    *entry -= depth * depth;
+    if (*entry < -MAX_HIST) TrimCaptHist();
+}
+
 int cEngine::Refutation(int move) {
     return refutation[Fsq(move)][Tsq(move)];
 }
+
+// Root moves are kept on a separate list for the whole search. The list is
+// built once with the usual move ordering and then sorted before each root
+// search, using scores and subtree sizes from the previous one.
+
+void cEngine::InitRootMoves(POS *p) {
+
+    MOVES *m = &stack[0].m;
+    UNDO u[1];
+    int move, mv_type, trans_move = 0;
+
+    TransRetrieveMove(p->hash_key, &trans_move);
+    InitMoves(p, m, trans_move, -1, -1, 0);
+    root_move_cnt = 0;
+
+    while ((move = NextMove(m, &mv_type))) {
+
+        // "go searchmoves" restricts the list
+
+        if (Glob.search_moves_cnt) {
+            bool is_allowed = false;
+            for (int i = 0; i < Glob.search_moves_cnt; i++)
+                if (Glob.search_moves[i] == move) is_allowed = true;
+            if (!is_allowed) continue;
+        }
+
+        p->DoMove(move, u);
+        if (!Illegal(p)) {
+            root_moves[root_move_cnt].move = move;
+            root_moves[root_move_cnt].score = -INF;
+            root_moves[root_move_cnt].nodes = 0;
+            root_move_cnt++;
+        }
+        p->UndoMove(move, u);
+    }
+
+    // Helper threads start with their own random order of moves behind the first
+
+    if (thread_id > 0) {
+        for (int i = root_move_cnt - 1; i > 1; i--) {
+            int j = 1 + RandomInt(i);
+            sRootMove tmp = root_moves[i];
+            root_moves[i] = root_moves[j];
+            root_moves[j] = tmp;
+        }
+    }
+
+    for (int i = 0; i < root_move_cnt; i++)
+        root_moves[i].order = i;
+}
+
+// Stable insertion sort: current best move first, then moves
+// by score from the last search. Moves with equal scores (mostly
+// the ones that failed low) go by subtree size in the main thread,
+// but keep their initial random order in helper threads, which
+// would otherwise follow the main thread's ordering.
+
+bool cEngine::RootTieBefore(const sRootMove& a, const sRootMove& b) {
+
+    if (thread_id > 0) return a.order < b.order;
+    return a.nodes > b.nodes;
+}
+
+void cEngine::SortRootMoves() {
+
+    int best_move = stack[0].pv[0];
+
+    for (int i = 1; i < root_move_cnt; i++) {
+        sRootMove tmp = root_moves[i];
+        int j = i;
+        while (j > 0
+        && root_moves[j - 1].move != best_move
+        && (tmp.move == best_move
+        ||  tmp.score > root_moves[j - 1].score
+        || (tmp.score == root_moves[j - 1].score && RootTieBefore(tmp, root_moves[j - 1])))) {
+            root_moves[j] = root_moves[j - 1];
+            j--;
+        }
+        root_moves[j] = tmp;
+    }
+}
+
+int cEngine::NextRootMove(POS *p, int idx, int *flag) {
+
+    if (idx >= root_move_cnt) return 0;
+
+    int move = root_moves[idx].move;
+
+    if (idx == 0)
+        *flag = MV_HASH;
+    else if (CaptVictim(p, move) != NO_TP)
+        *flag = BadCapture(p, move) ? MV_BADCAPT : MV_CAPTURE;
+    else if (IsProm(move))
+        *flag = MV_CAPTURE;
+    else if (move == stack[0].killer[0] || move == stack[0].killer[1])
+        *flag = MV_KILLER;
+    else
+        *flag = MV_NORMAL;
+
+    return move;
+}
+
+// Move loop of Search() takes moves from the generator first, then
+// the ones deferred because another thread was busy searching them
+
+int cEngine::NextSearchMove(POS *p, int ply, int *root_idx, int *flag) {
+
+    sSearchStack *ss = &stack[ply];
+
+    if (ss->deferred_next < 0) {
+        int move = ply ? NextMove(&ss->m, flag) : NextRootMove(p, (*root_idx)++, flag);
+        if (move) return move;
+        ss->deferred_next = 0;
+    }
+
+    if (ss->deferred_next < ss->deferred_cnt) {
+        *flag = ss->deferred_flag[ss->deferred_next];
+        return ss->deferred[ss->deferred_next++];
+    }
+
+    return 0;
+}
@@ -26,6 +26,7 @@ void cParam::DefaultWeights() {
 
     search_skill = 10;
     nps_limit = 0;
+    nps_by_nodes = true;
     fl_weakening = false;
     elo = 2800;
     eval_blur = 0;
@@ -456,9 +457,9 @@ int cParam::EloToBookDepth(int elo_in) {
     return 256;
 }
 
-void cDistance::Init() {
+constexpr cDistance::cDistance() : metric(), bonus() {
 
-    // Init distance tables
+    // Init distance tables (at compile time, see Dist below)
 
     for (int sq1 = 0; sq1 < 64; ++sq1) {
         for (int sq2 = 0; sq2 < 64; ++sq2) {
@@ -470,6 +471,8 @@ void cDistance::Init() {
     }
 }
 
+constexpr cDistance Dist;
+
 void cParam::SetVal(int slot, int val) {
     values[slot] = val;
 }
@@ -22,47 +22,52 @@ If not, see <http://www.gnu.org/licenses/>.
 // as well as special quiet moves (hash and killers). It improves engines'
 // tactical awareness near the leaves and after a null move.
 
-int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
+int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta) {
 
-    int best, score, move, new_pv[MAX_PLY];
+    int best, score, move;
     int mv_type;//, fl_check;
     int is_pv = (alpha != beta - 1);
-    MOVES m[1];
+    int *pv = stack[ply].pv;
+    int *new_pv = stack[ply + 1].pv;
+    MOVES *m = &stack[ply].m;
     UNDO u[1];
-    eData e;
 
-    if (InCheck(p)) return QuiesceFlee(p, ply, alpha, beta, pv);
+    if (InCheck(p)) return QuiesceFlee(p, ply, alpha, beta);
 
     // EARLY EXIT AND NODE INITIALIZATION
 
     Glob.nodes++;
-    //local_nodes++; unused
+    local_nodes++;
     Slowdown();
     if (Glob.abort_search && root_depth > 1) return 0;
     *pv = 0;
+    rep_list[p->head] = p->hash_key;
     if (IsDraw(p) && ply) return DrawScore(p);
     move = 0;
 
+    // RETRIEVE MOVE FROM TRANSPOSITION TABLE
+
+    int raw_eval = -INF;
+    if (TransRetrieve(p->hash_key, &move, &score, &raw_eval, alpha, beta, 0, ply)) {
+        if (score >= beta) UpdateHistory(p, -1, move, 1, ply);
+        if (!is_pv) return score;
+    }
+
     // DETERMINE FLOOR VALUE
+    // (reuse static eval from the transposition table if possible)
 
-    best = Evaluate(p, &e);
+    if (raw_eval == -INF) raw_eval = Evaluate(p, &e_data);
+    best = raw_eval;
 #ifdef USE_RISKY_PARAMETER
     best = EvalScaleByDepth(p, ply, best);
 #endif
     if (best >= beta) return best;
     if (best > alpha) alpha = best;
 
-    // RETRIEVE MOVE FROM TRANSPOSITION TABLE
-
-    if (TransRetrieve(p->hash_key, &move, &score, alpha, beta, 0, ply)) {
-        if (score >= beta) UpdateHistory(p, -1, move, 1, ply);
-        if (!is_pv) return score;
-    }
-
     // SAFEGUARD AGAINST REACHING MAX PLY LIMIT
 
     if (ply >= MAX_PLY - 1) {
-        int eval = Evaluate(p, &e);
+        int eval = Evaluate(p, &e_data);
 #ifdef USE_RISKY_PARAMETER
         eval = EvalScaleByDepth(p, ply, eval);
 #endif
@@ -81,20 +86,20 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
         // MAKE MOVE
 
-        p->DoMove(move, u);
-        if (Illegal(p)) { p->UndoMove(move, u); continue; }
+        p = MakeMove(p, move, u);
+        if (Illegal(p)) { p = UnmakeMove(p, move, u); continue; }
 
-        score = -Quiesce(p, ply + 1, -beta, -alpha, new_pv);
+        score = -Quiesce(p, ply + 1, -beta, -alpha);
 
         // UNDO MOVE
 
-        p->UndoMove(move, u);
+        p = UnmakeMove(p, move, u);
         if (Glob.abort_search && root_depth > 1) return 0;
 
         // BETA CUTOFF
 
         if (score >= beta) {
-            TransStore(p->hash_key, move, score, LOWER, 0, ply);
+            TransStore(p->hash_key, move, score, raw_eval, LOWER, 0, ply);
             return score;
         }
 
@@ -117,34 +122,36 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // SAVE RESULT IN THE TRANSPOSITION TABLE
 
-    if (*pv) TransStore(p->hash_key, *pv, best, EXACT, 0, ply);
-    else     TransStore(p->hash_key,   0, best, UPPER, 0, ply);
+    if (*pv) TransStore(p->hash_key, *pv, best, raw_eval, EXACT, 0, ply);
+    else     TransStore(p->hash_key,   0, best, raw_eval, UPPER, 0, ply);
 
     return best;
 }
 
-int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
+int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta) {
 
-    int best, score, move, new_pv[MAX_PLY];
+    int best, score, move, tt_eval;
     int mv_type;//, fl_check;
     int is_pv = (alpha != beta - 1);
-    MOVES m[1];
+    int *pv = stack[ply].pv;
+    int *new_pv = stack[ply + 1].pv;
+    MOVES *m = &stack[ply].m;
     UNDO u[1];
-    eData e;
 
     // EARLY EXIT AND NODE INITIALIZATION
 
     Glob.nodes++;
-    //local_nodes++; unused
+    local_nodes++;
     Slowdown();
     if (Glob.abort_search && root_depth > 1) return 0;
     *pv = 0;
+    rep_list[p->head] = p->hash_key;
     if (IsDraw(p) && ply) return DrawScore(p);
     move = 0;
 
     // RETRIEVE MOVE FROM TRANSPOSITION TABLE
 
-    if (TransRetrieve(p->hash_key, &move, &score, alpha, beta, 0, ply)) {
+    if (TransRetrieve(p->hash_key, &move, &score, &tt_eval, alpha, beta, 0, ply)) {
         if (score >= beta) UpdateHistory(p, -1, move, 1, ply);
         if (!is_pv) return score;
     }
@@ -152,7 +159,7 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
     // SAFEGUARD AGAINST REACHING MAX PLY LIMIT
 
     if (ply >= MAX_PLY - 1) {
-        int eval = Evaluate(p, &e);
+        int eval = Evaluate(p, &e_data);
 #ifdef USE_RISKY_PARAMETER
         eval = EvalScaleByDepth(p, ply, eval);
 #endif
@@ -172,20 +179,20 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
 
         // MAKE MOVE
 
-        p->DoMove(move, u);
-        if (Illegal(p)) { p->UndoMove(move, u); continue; }
+        p = MakeMove(p, move, u);
+        if (Illegal(p)) { p = UnmakeMove(p, move, u); continue; }
 
-        score = -Quiesce(p, ply + 1, -beta, -alpha, new_pv);
+        score = -Quiesce(p, ply + 1, -beta, -alpha);
 
         // UNDO MOVE
 
-        p->UndoMove(move, u);
+        p = UnmakeMove(p, move, u);
         if (Glob.abort_search && root_depth > 1) return 0;
 
         // BETA CUTOFF
 
         if (score >= beta) {
-            TransStore(p->hash_key, move, score, LOWER, 0, ply);
+            TransStore(p->hash_key, move, score, -INF, LOWER, 0, ply);
             return score;
         }
 
@@ -208,38 +215,40 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // SAVE RESULT IN THE TRANSPOSITION TABLE
 
-    if (*pv) TransStore(p->hash_key, *pv, best, EXACT, 0, ply);
-    else     TransStore(p->hash_key,   0, best, UPPER, 0, ply);
+    if (*pv) TransStore(p->hash_key, *pv, best, -INF, EXACT, 0, ply);
+    else     TransStore(p->hash_key,   0, best, -INF, UPPER, 0, ply);
 
     return best;
 }
 
-int cEngine::Quiesce(POS *p, int ply, int alpha, int beta, int *pv) {
+int cEngine::Quiesce(POS *p, int ply, int alpha, int beta) {
 
-    int best, score, move, new_pv[MAX_PLY];
+    int best, score, move;
     int op = Opp(p->side);
-    MOVES m[1];
+    int *pv = stack[ply].pv;
+    int *new_pv = stack[ply + 1].pv;
+    MOVES *m = &stack[ply].m;
     UNDO u[1];
-    eData e;
 
     // USE DEDICATED EVASION SEARCH WHEN IN CHECK
 
-    if (InCheck(p)) return QuiesceFlee(p, ply, alpha, beta, pv);
+    if (InCheck(p)) return QuiesceFlee(p, ply, alpha, beta);
 
     Glob.nodes++;
-    //local_nodes++; unused
+    local_nodes++;
     Slowdown();
 
     // EARLY EXIT
 
     if (Glob.abort_search && root_depth > 1) return 0;
     *pv = 0;
+    rep_list[p->head] = p->hash_key;
     if (IsDraw(p)) return DrawScore(p);
 
     // SAFEGUARD AGAINST HITTIMG MAX PLY LIMIT
 
     if (ply >= MAX_PLY - 1) {
-        int eval = Evaluate(p, &e);
+        int eval = Evaluate(p, &e_data);
 #ifdef USE_RISKY_PARAMETER
         eval = EvalScaleByDepth(p, ply, eval);
 #endif
@@ -248,7 +257,7 @@ int cEngine::Quiesce(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // GET STAND PAT SCORE
 
-    best = Evaluate(p, &e);
+    best = Evaluate(p, &e_data);
 #ifdef USE_RISKY_PARAMETER
     best = EvalScaleByDepth(p, ply, best);
 #endif
@@ -298,16 +307,18 @@ int cEngine::Quiesce(POS *p, int ply, int alpha, int beta, int *pv) {
             if (BadCapture(p, move)) continue;
         }
 
-        p->DoMove(move, u);
-        if (Illegal(p)) { p->UndoMove(move, u); continue; }
-        score = -Quiesce(p, ply + 1, -beta, -alpha, new_pv);
-        p->UndoMove(move, u);
+        p = MakeMove(p, move, u);
+        if (Illegal(p)) { p = UnmakeMove(p, move, u); continue; }
+        score = -Quiesce(p, ply + 1, -beta, -alpha);
+        p = UnmakeMove(p, move, u);
         if (Glob.abort_search && root_depth > 1) return 0;
 
         // BETA CUTOFF
 
-        if (score >= beta)
+        if (score >= beta) {
+            UpdateCaptHistory(p, move, 1);
             return score;
+        }
 
         // ADJUST ALPHA AND SCORE
 
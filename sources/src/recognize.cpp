@@ -17,6 +17,108 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include "rodent.h"
 
+// Cuckoo tables hold the hash key difference of every piece move on an empty
+// board, so a single lookup tells whether two positions are one move apart
+// (method by Marcel van Kervinck, as used in Stockfish)
+
+#define CUCKOO_SIZE 8192
+
+struct sCuckoo {
+    U64 key[CUCKOO_SIZE];
+    int move[CUCKOO_SIZE];
+};
+
+// Zobrist keys come from a LCG, so only their high bits are well mixed
+
+static constexpr int CuckooH1(U64 key) { return (int)(key >> 51); }
+static constexpr int CuckooH2(U64 key) { return (int)(key >> 35) & (CUCKOO_SIZE - 1); }
+
+static constexpr bool PieceReaches(int tp, int sq1, int sq2) {
+
+    int file_diff = Abs(File(sq1) - File(sq2));
+    int rank_diff = Abs(Rank(sq1) - Rank(sq2));
+    bool diag = (file_diff == rank_diff);
+    bool line = (file_diff == 0 || rank_diff == 0);
+
+    switch (tp) {
+        case N: return (cBitBoard::KnightAttacks(sq1) & SqBb(sq2)) != 0;
+        case B: return diag;
+        case R: return line;
+        case Q: return diag || line;
+        case K: return (cBitBoard::KingAttacks(sq1) & SqBb(sq2)) != 0;
+    }
+    return false;
+}
+
+static constexpr sCuckoo InitCuckoo() {
+
+    sCuckoo c = {};
+    const sZobrist zob = InitZobrist();
+
+    for (int pc = WN; pc <= BK; pc++) {
+        for (int sq1 = 0; sq1 < 64; sq1++) {
+            for (int sq2 = sq1 + 1; sq2 < 64; sq2++) {
+                if (!PieceReaches(Tp(pc), sq1, sq2)) continue;
+
+                U64 key = zob.piece[pc][sq1] ^ zob.piece[pc][sq2] ^ SIDE_RANDOM;
+                int move = (sq2 << 6) | sq1;
+                int i = CuckooH1(key);
+
+                // insert, kicking out whatever was there to its other slot
+
+                for (;;) {
+                    U64 tmp_key = c.key[i]; c.key[i] = key; key = tmp_key;
+                    int tmp_move = c.move[i]; c.move[i] = move; move = tmp_move;
+                    if (move == 0) break;
+                    i = (i == CuckooH1(key)) ? CuckooH2(key) : CuckooH1(key);
+                }
+            }
+        }
+    }
+
+    return c;
+}
+
+static constexpr sCuckoo cuckoo = InitCuckoo();
+
+// UpcomingRepetition() tells whether the side to move has a move leading
+// back to a position on the repetition list. Detects draws one ply earlier
+// than IsDraw() does.
+
+bool cEngine::UpcomingRepetition(POS *p, int ply) {
+
+    int last = Min(p->rev_moves, p->head);
+    if (last < 3) return false;
+
+    U64 bb_occ = OccBb(p);
+
+    for (int i = 3; i <= last; i += 2) {
+        U64 move_key = p->hash_key ^ rep_list[p->head - i];
+        int idx = CuckooH1(move_key);
+
+        if (cuckoo.key[idx] != move_key) {
+            idx = CuckooH2(move_key);
+            if (cuckoo.key[idx] != move_key) continue;
+        }
+
+        int fsq = Fsq(cuckoo.move[idx]);
+        int tsq = Tsq(cuckoo.move[idx]);
+
+        if (BB.Between(fsq, tsq) & bb_occ) continue;
+
+        // Cycle within the search tree
+
+        if (ply > i) return true;
+
+        // Position from the game history: the move must belong to the side to move
+
+        int sq = (p->pc[fsq] == NO_PC) ? tsq : fsq;
+        if (Cl(p->pc[sq]) == p->side) return true;
+    }
+
+    return false;
+}
+
 bool cEngine::IsDraw(POS *p) {
 
     // Draw by 50 move rule
@@ -25,8 +127,14 @@ bool cEngine::IsDraw(POS *p) {
 
     // Draw by repetition
 
-    for (int i = 4; i <= p->rev_moves; i += 2)
-        if (p->hash_key == p->rep_list[p->head - i]) return true;
+    // (skip the scan if no earlier position shares the filter slot of this one)
+
+    if (rep_filter[RepIndex(p->hash_key)]) {
+        int last = Min(p->rev_moves, p->head); // positions before the root FEN are unknown
+
+        for (int i = 4; i <= last; i += 2)
+            if (p->hash_key == rep_list[p->head - i]) return true;
+    }
 
     // With no major pieces on the board, we have some heuristic draws to consider
 
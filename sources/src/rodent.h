@@ -38,10 +38,14 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <cinttypes>
 
 using U64 = uint64_t;
+using MOVE = uint16_t; // start square, target square and move type, see Fsq(), Tsq() and MoveType()
 
 // define how Rodent is to be compiled
 
 #define USE_MAGIC
+//#define USE_PEXT // BMI2 sliding attacks, set by `make build-bmi2`
+//#define USE_FILL_ATT_MAPS // eval attack maps from set-wise fills (AVX2 when available), not faster so far
+//#define USE_COPY_MAKE // search makes moves on a copy of the position, set by `make build-copymake`
 #ifndef NO_MM_POPCNT
     #define USE_MM_POPCNT
 #endif
@@ -63,7 +67,7 @@ using U64 = uint64_t;
     #ifndef NEW_THREADS
         #define NEW_THREADS
     #endif
-    #define MAX_THREADS 8
+    #define MAX_THREADS 32
 #else
     #undef USE_THREADS
 #endif
@@ -96,6 +100,9 @@ enum eSquare {
 
 #define MAX_PLY         64
 #define MAX_MOVES       256
+#define REP_LIST_SIZE   256 // game positions kept for repetition detection
+#define REP_FILTER_BITS 10  // log2 of the repetition filter size, see cEngine::rep_filter
+#define MAX_MULTIPV     16
 #define INF             32767
 #define MATE            32000
 #define MAX_EVAL        29999
@@ -129,7 +136,7 @@ enum eSquare {
 #define bbWhiteSq       (U64)0x55AA55AA55AA55AA
 #define bbBlackSq       (U64)0xAA55AA55AA55AA55
 
-static const U64 bb_rel_rank[2][8] = {
+static constexpr U64 bb_rel_rank[2][8] = {
     { RANK_1_BB, RANK_2_BB, RANK_3_BB, RANK_4_BB, RANK_5_BB, RANK_6_BB, RANK_7_BB, RANK_8_BB },
     { RANK_8_BB, RANK_7_BB, RANK_6_BB, RANK_5_BB, RANK_4_BB, RANK_3_BB, RANK_2_BB, RANK_1_BB }
 };
@@ -151,11 +158,11 @@ static const U64 bb_central_file = FILE_C_BB | FILE_D_BB | FILE_E_BB | FILE_F_BB
 #define Sq(x, y)        (((y) << 3) | (x))
 
 //#define Abs(x)          ((x) > 0 ? (x) : -(x))
-template<typename T> T Abs(const T& x) { return x > 0 ? x : -x; }
+template<typename T> constexpr T Abs(const T& x) { return x > 0 ? x : -x; }
 //#define Max(x, y)       ((x) > (y) ? (x) : (y))
-template<typename T> const T& Max(const T& x, const T& y) { return x > y ? x : y; }
+template<typename T> constexpr const T& Max(const T& x, const T& y) { return x > y ? x : y; }
 //#define Min(x, y)       ((x) < (y) ? (x) : (y))
-template<typename T> const T& Min(const T& x, const T& y) { return x < y ? x : y; }
+template<typename T> constexpr const T& Min(const T& x, const T& y) { return x < y ? x : y; }
 
 #define Fsq(x)          ((x) & 63)
 #define Tsq(x)          (((x) >> 6) & 63)
@@ -163,6 +170,10 @@ template<typename T> const T& Min(const T& x, const T& y) { return x < y ? x : y
 #define IsProm(x)       ((x) & 0x4000)
 #define PromType(x)     (((x) >> 12) - 3)
 
+#define MAX_MOVE_SCORE  32767 // move ordering score, packed with the move into one int on move lists
+#define PackMove(x, sc) ((sc) * 65536 + (x))
+#define UnpackMove(x)   ((x) & 0xffff)
+
 #define Opp(x)          ((x) ^ 1)
 
 #define InCheck(p)      Attacked(p, KingSq(p, p->side), Opp(p->side))
@@ -262,54 +273,7 @@ template<typename T> const T& Min(const T& x, const T& y) { return x < y ? x : y
 //#define MoreThanOne(bb) ((bb) & ((bb) - 1))
 template<typename T> bool MoreThanOne(const T& bb) { return bb & (bb - 1); }
 
-class cBitBoard {
-  private:
-    U64 p_attacks[2][64];
-    U64 n_attacks[64];
-    U64 k_attacks[64];
-
-#ifndef USE_MAGIC
-    U64 FillOcclSouth(U64 bb_start, U64 bb_block);
-    U64 FillOcclNorth(U64 bb_start, U64 bb_block);
-    U64 FillOcclEast(U64 bb_start, U64 bb_block);
-    U64 FillOcclWest(U64 bb_start, U64 bb_block);
-    U64 FillOcclNE(U64 bb_start, U64 bb_block);
-    U64 FillOcclNW(U64 bb_start, U64 bb_block);
-    U64 FillOcclSE(U64 bb_start, U64 bb_block);
-    U64 FillOcclSW(U64 bb_start, U64 bb_block);
-#endif
-
-    U64 GetBetween(int sq1, int sq2);
-
-  public:
-    U64 bbBetween[64][64];
-    void Init();
-    void Print(U64 bb);
-    U64 ShiftFwd(U64 bb, int sd);
-    U64 ShiftSideways(U64 bb);
-    U64 GetWPControl(U64 bb);
-    U64 GetBPControl(U64 bb);
-    U64 GetPawnControl(U64 bb, int sd);
-    U64 GetDoubleWPControl(U64 bb);
-    U64 GetDoubleBPControl(U64 bb);
-    U64 GetFrontSpan(U64 bb, int sd);
-    U64 FillNorth(U64 bb);
-    U64 FillSouth(U64 bb);
-    U64 FillNorthSq(int sq);
-    U64 FillSouthSq(int sq);
-    U64 FillNorthExcl(U64 bb);
-    U64 FillSouthExcl(U64 bb);
-
-    int PopCnt(U64);
-    int PopFirstBit(U64 *bb);
-
-    U64 PawnAttacks(int sd, int sq);
-    U64 KingAttacks(int sq);
-    U64 KnightAttacks(int sq);
-    U64 RookAttacks(U64 occ, int sq);
-    U64 BishAttacks(U64 occ, int sq);
-    U64 QueenAttacks(U64 occ, int sq);
-};
+#include "bitboard.h"
 
 extern cBitBoard BB;
 
@@ -322,30 +286,59 @@ struct UNDO {
     U64 pawn_key;
 };
 
+// Zobrist keys are generated at compile time by a linear congruential
+// generator; the internal book depends on this exact sequence
+
+struct sZobrist {
+    U64 piece[12][64];
+    U64 castle[16];
+    U64 ep[8];
+};
+
+constexpr sZobrist InitZobrist() {
+
+    sZobrist z = {};
+    U64 next = 1;
+
+    for (int i = 0; i < 12; i++)
+        for (int j = 0; j < 64; j++)
+            z.piece[i][j] = next = next * 1103515245 + 12345;
+    for (int i = 0; i < 16; i++)
+        z.castle[i] = next = next * 1103515245 + 12345;
+    for (int i = 0; i < 8; i++)
+        z.ep[i] = next = next * 1103515245 + 12345;
+
+    return z;
+}
+
 class POS {
-    static int castle_mask[64];
-    static U64 zob_piece[12][64];
-    static U64 zob_castle[16];
-    static U64 zob_ep[8];
+    static constexpr int castle_mask[64] = {
+        13, 15, 15, 15, 12, 15, 15, 14,
+        15, 15, 15, 15, 15, 15, 15, 15,
+        15, 15, 15, 15, 15, 15, 15, 15,
+        15, 15, 15, 15, 15, 15, 15, 15,
+        15, 15, 15, 15, 15, 15, 15, 15,
+        15, 15, 15, 15, 15, 15, 15, 15,
+        15, 15, 15, 15, 15, 15, 15, 15,
+         7, 15, 15, 15,  3, 15, 15, 11
+    };
+    static constexpr sZobrist zob = InitZobrist();
   public:
-    U64 cl_bb[2];
+    U64 cl_bb[2];       // hot fields first, bitboards fill one cache line
     U64 tp_bb[6];
-    int pc[64];
-    int king_sq[2];
-    int phase;
-    int cnt[2][6];
+    U64 hash_key;
+    U64 pawn_key;
     int mg_sc[2];
     int eg_sc[2];
+    int phase;
     int side;
     int c_flags;
     int ep_sq;
     int rev_moves;
-    int head;
-    U64 hash_key;
-    U64 pawn_key;
-    U64 rep_list[256];
-
-    static void Init();
+    int head;           // index of this position in the repetition list (see cEngine::rep_list)
+    uint8_t king_sq[2];
+    uint8_t cnt[2][6];
+    uint8_t pc[64];
 
     U64 Pawns(int sd) const {
         return (cl_bb[sd] & tp_bb[P]);
@@ -399,17 +392,56 @@ struct MOVES {
     int killer2;
     int *next;
     int *last;
-    int move[MAX_MOVES];
-    int value[MAX_MOVES];
-    int *badp;
-    int bad[MAX_MOVES];
+    int *badp;             // end of bad captures, kept at the start of move[]
+    int move[MAX_MOVES];   // moves with their scores, see PackMove()
+};
+
+// Per-ply search data, kept in a contiguous per-thread array instead of being
+// passed down as Search() arguments or allocated on every stack frame.
+// The first three fields describe how the node was reached and are set by the caller.
+
+struct sSearchStack {
+    int was_null;               // node reached by a null move or searched for null move verification
+    int last_move;              // move leading to this node, 0 = null move, -1 = don't update refutation table
+    int last_capt_sq;           // square of a capture leading to this node, -1 = no capture
+    int excluded_move;          // move skipped by singular extension search, 0 = none
+    int eval;                   // static eval, -INF if it was not needed
+    int killer[2];
+    int pv[MAX_PLY];            // triangular pv array: best line found from this node
+    MOVE mv_played[MAX_MOVES];  // moves searched so far, for history updates
+    MOVE deferred[MAX_MOVES];   // moves put off because another thread was searching them
+    uint8_t deferred_flag[MAX_MOVES];
+    int deferred_cnt;
+    int deferred_next;          // -1 = moves are still taken from the move generator
+    MOVES m;
+};
+
+// Root move with statistics from the last search, used for ordering
+
+struct sRootMove {
+    int move;
+    int score;                  // -INF if the move did not raise alpha
+    U64 nodes;                  // size of its subtree
+    int order;                  // place on the initial list, shuffled for helper threads
+};
+
+// Root line reported in MultiPV mode
+
+struct sRootLine {
+    int score;
+    int pv[MAX_PLY];
 };
 
+// Transposition table entry. Lower bits of the hash key are implied by the
+// entry's location in the table, so only the upper 32 bits are kept, which
+// leaves room for the static eval within 16 bytes.
+
 struct ENTRY {
-    U64 key;
-    short date;
+    uint32_t key;
     short move;
     short score;
+    short eval;
+    unsigned char date;
     unsigned char flags;
     unsigned char depth;
 };
@@ -471,6 +503,7 @@ class cParam {
     int prog_side;
     int search_skill;
     int nps_limit;
+    bool nps_by_nodes;  // enforce nps_limit with a node budget per move rather than by waiting
     int eval_blur;
     int hist_perc;
     int hist_limit;
@@ -539,14 +572,14 @@ class cDistance {
   public:
     int metric[64][64]; // chebyshev distance for unstoppable passers
     int bonus[64][64];
-    void Init();
+    constexpr cDistance();
 };
 
-extern cDistance Dist;
+extern const cDistance Dist;
 
 class cMask {
   public:
-    void Init();
+    constexpr cMask();
     U64 k_side;
     U64 q_side;
     U64 home[2];
@@ -561,7 +594,7 @@ class cMask {
     U64 bb_special;
 };
 
-extern cMask Mask;
+extern const cMask Mask;
 
 #if defined(USE_THREADS) && defined(NEW_THREADS)
     #include <atomic>
@@ -579,6 +612,7 @@ class cGlobals {
   public:
     glob_U64 nodes;
     glob_bool abort_search;
+    glob_bool fail_low;     // root search failed low in the current iteration
     glob_bool is_testing;
     bool elo_slider;
     bool is_console;
@@ -593,6 +627,13 @@ class cGlobals {
     glob_int depth_reached;
     int moves_from_start; // to restrict book depth for weaker levels
     int thread_no;
+    int multi_pv;
+    bool deterministic;          // threads take turns, for reproducible multi-threaded runs
+    bool use_abdada;             // threads defer moves searched by other threads, off = plain Lazy SMP
+    bool node_budget;            // nps_limit is enforced by a node budget in this search, not by waiting
+    int search_moves[MAX_MOVES]; // root moves allowed by "go searchmoves"
+    int search_moves_cnt;        // 0 = all moves
+    U64 rep_list[REP_LIST_SIZE]; // hash keys of game positions before the root, indexed by POS::head
 
     void ClearData();
     void Init();
@@ -649,26 +690,53 @@ extern
 sInternalBook InternalBook;
 
 void CheckTimeout();
+void CheckDeadline();
 
 #define EVAL_HASH_SIZE 512 * 512 / 4
 #define PAWN_HASH_SIZE 512 * 512 / 4
 
+// Late move reductions by [pv][improving][depth][moves tried], the move count
+// saturates at 63
+
+struct sLmrTable {
+    signed char size[2][2][MAX_PLY][64];
+};
+
 class cEngine {
     sEvalHashEntry EvalTT[EVAL_HASH_SIZE];
     sPawnHashEntry PawnTT[PAWN_HASH_SIZE];
     int history[12][64];
-    int killer[MAX_PLY][2];
-    int refutation[64][64];
-    //int local_nodes;
+    int capt_history[12][64][6];
+    sSearchStack stack[MAX_PLY + 1];
+    U64 rep_list[REP_LIST_SIZE + MAX_PLY]; // game history, then keys of the positions on the search path
+    uint16_t rep_filter[1 << REP_FILTER_BITS]; // counts of rep_list keys below the current head, by RepIndex
+#ifdef USE_COPY_MAKE
+    POS pos_stack[MAX_PLY + 1];            // position of each ply, search starts at pos_stack[0]
+#endif
+    eData e_data;
+    MOVE refutation[64][64];
+    U64 local_nodes; // nodes searched by this thread
+    int time_check_cnt; // nodes left until the next look at the clock
     const int thread_id;
     int root_depth;
     bool fl_root_choice;
+    U64 rand_state;     // per-thread random numbers for Lazy SMP diversification
+    sRootMove root_moves[MAX_MOVES];
+    int root_move_cnt;
+    sRootLine root_lines[MAX_MULTIPV];
+    int multi_pv;   // number of root lines searched, set at the start of Iterate()
+    int pv_idx;     // root line being searched, better lines are excluded
 
     void InitCaptures(POS *p, MOVES *m);
     void InitMoves(POS *p, MOVES *m, int trans_move, int ref_move, int ref_sq, int ply);
     int NextMove(MOVES *m, int *flag);
     int NextSpecialMove(MOVES *m, int *flag);
     int NextCapture(MOVES *m);
+    void InitRootMoves(POS *p);
+    bool RootTieBefore(const sRootMove& a, const sRootMove& b);
+    void SortRootMoves();
+    int NextRootMove(POS *p, int idx, int *flag);
+    int NextSearchMove(POS *p, int ply, int *root_idx, int *flag);
     void ScoreCaptures(MOVES *m);
     void ScoreQuiet(MOVES *m);
     int SelectBest(MOVES *m);
@@ -676,22 +744,94 @@ class cEngine {
     int MvvLva(POS *p, int move);
     void ClearHist();
     void AgeHist();
+    void PerturbHist();
+    int RandomInt(int range) {
+        rand_state ^= rand_state << 13; // xorshift64
+        rand_state ^= rand_state >> 7;
+        rand_state ^= rand_state << 17;
+        return (int)(rand_state % range);
+    }
+    void ClearKillers();
     void ClearEvalHash();
     void ClearPawnHash();
     int Refutation(int move);
     void UpdateHistory(POS *p, int last_move, int move, int depth, int ply);
     void DecreaseHistory(POS *p, int move, int depth);
     void TrimHist();
+    int CaptVictim(POS *p, int move);
+    void UpdateCaptHistory(POS *p, int move, int depth);
+    void DecreaseCaptHistory(POS *p, int move, int depth);
+    void TrimCaptHist();
 
     void Iterate(POS *p, int *pv);
-    int Widen(POS *p, int depth, int *pv, int lastScore);
-    int Search(POS *p, int ply, int alpha, int beta, int depth, int was_null, int last_move, int last_capt_sq, int *pv);
-    int QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv);
-    int QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv);
-    int Quiesce(POS *p, int ply, int alpha, int beta, int *pv);
+#ifdef USE_THREADS
+    void TakeTurn(bool has_turn);
+    void EndTurn();
+#endif
+    int Widen(POS *p, int depth, int lastScore);
+    int Search(POS *p, int ply, int alpha, int beta, int depth);
+    int QuiesceChecks(POS *p, int ply, int alpha, int beta);
+    int QuiesceFlee(POS *p, int ply, int alpha, int beta);
+    int Quiesce(POS *p, int ply, int alpha, int beta);
+
+    // Moves are made in place and taken back using UNDO, or with USE_COPY_MAKE
+    // made on a copy in the next slot of pos_stack, so that taking them back
+    // is only a pointer decrement. Both also keep rep_filter up to date.
+
+    static int RepIndex(U64 key) { return (int)(key >> (64 - REP_FILTER_BITS)); }
+
+    POS *MakeMove(POS *p, int move, UNDO *u) {
+        rep_filter[RepIndex(p->hash_key)]++;
+#ifdef USE_COPY_MAKE
+        p[1] = *p;
+        p++;
+#endif
+        p->DoMove(move, u);
+        return p;
+    }
+
+    POS *UnmakeMove(POS *p, int move, UNDO *u) {
+#ifdef USE_COPY_MAKE
+        p--;
+#else
+        p->UndoMove(move, u);
+#endif
+        rep_filter[RepIndex(p->hash_key)]--;
+        return p;
+    }
+
+    POS *MakeNull(POS *p, UNDO *u) {
+        rep_filter[RepIndex(p->hash_key)]++;
+#ifdef USE_COPY_MAKE
+        p[1] = *p;
+        p++;
+#endif
+        p->DoNull(u);
+        return p;
+    }
+
+    POS *UnmakeNull(POS *p, UNDO *u) {
+#ifdef USE_COPY_MAKE
+        p--;
+#else
+        p->UndoNull(u);
+#endif
+        rep_filter[RepIndex(p->hash_key)]--;
+        return p;
+    }
+
+    void SetNodeInfo(int ply, int was_null, int last_move, int last_capt_sq) {
+        stack[ply].was_null = was_null;
+        stack[ply].last_move = last_move;
+        stack[ply].last_capt_sq = last_capt_sq;
+        stack[ply].excluded_move = 0;
+    }
+    bool IsRootExcluded(int move);
     bool IsDraw(POS *p);
+    bool UpcomingRepetition(POS *p, int ply);
     bool KPKdraw(POS *p, int sd);
-    void DisplayPv(int score, int *pv);
+    void DisplayPv(int line, int score, int *pv);
+    void DisplayRootLines();
     void Slowdown();
 
     int Evaluate(POS *p, eData *e);
@@ -729,15 +869,15 @@ class cEngine {
     bool NotOnBishColor(POS *p, int bish_side, int sq);
     bool DifferentBishops(POS *p);
 
-    static const int razor_margin[];
-    static const int fut_margin[];
-    static int lmr_size[2][MAX_PLY][MAX_MOVES];
+    static const int razor_margin[2][5];
+    static const int fut_margin[2][7];
+    static const int lmp_limit[2][4];
+    static const sLmrTable lmr;
 
   public:
 
-    static void InitSearch();
-
     int pv_eng[MAX_PLY];
+    int score_eng;      // score of pv_eng from the last completed iteration
     int dp_completed;
 
     cEngine(const cEngine&) = delete;
@@ -764,6 +904,12 @@ class cEngine {
 #ifdef USE_THREADS
     #include <list>
     extern std::list<cEngine> Engines;
+    void SmpBench(int depth, int max_threads);
+    void StartTurns(int threads);
+    void StopTurns();
+    bool IsBusy(U64 key);
+    void SetBusy(U64 key);
+    void ClearBusy(U64 key);
 #else
     extern cEngine EngineSingle;
 #endif
@@ -780,6 +926,7 @@ struct sPersAliases {
 void PrintVersion();
 
 int BulletCorrection(int time);
+bool TimeToStop(int elapsed, int iteration_time, int stable_iterations, int score_drop);
 int Clip(int sc, int lim);
 void AllocTrans(unsigned int mbsize);
 bool Attacked(POS *p, int sq, int sd);
@@ -798,6 +945,7 @@ bool CanDiscoverCheck(POS *p, U64 bb_checkers, int op, int from); // for Generat
 int GetMS();
 U64 GetNps(int elapsed);
 bool InputAvailable();
+bool IsMoveStr(const char *str);
 bool Legal(POS *p, int move);
 char *MoveToStr(int move);
 void MoveToStr(int move, char *move_str);
@@ -810,7 +958,6 @@ void PrintBoard(POS *p);
 void PrintMove(int move);
 void PrintUciOptions();
 void PvToStr(int *, char *);
-U64 Random64();
 void ReadLine(char *, int);
 void ReadPersonality(const char *fileName);
 void SetPosition(POS *p, const char *epd);
@@ -818,17 +965,24 @@ void SetMoveTime(int base, int inc, int movestogo);
 void SetPieceValue(int pc, int val, int slot);
 int StrToMove(POS *p, char *move_str);
 int Swap(POS *p, int from, int to);
-bool TransRetrieve(U64 key, int *move, int *score, int alpha, int beta, int depth, int ply);
+bool SeeGe(POS *p, int from, int to, int threshold);
+bool TransRetrieve(U64 key, int *move, int *score, int *eval, int alpha, int beta, int depth, int ply);
 void TransRetrieveMove(U64 key, int *move);
-void TransStore(U64 key, int move, int score, int flags, int depth, int ply);
+bool TransRetrieveEntry(U64 key, int *score, int *flags, int *depth, int ply);
+void TransStore(U64 key, int move, int score, int eval, int flags, int depth, int ply);
 void UciLoop();
 void WasteTime(int miliseconds);
 void PrintBb(U64 bbTest);
+void PrintStartupTimes();
+void SliderBench(int iterations);
+void SeeBench(int iterations);
+U64 Perft(POS *p, int depth);
 int big_random(int n);
 
 extern const int tp_value[7];
 extern const int ph_value[7];
-extern int move_time;
+extern int move_time;  // maximum time for this move
+extern int opt_time;   // optimum time for this move, -1 = no time management
 extern int move_nodes;
 extern int search_depth;
 extern int start_time;
@@ -882,7 +1036,6 @@ extern int tt_date;
 // TODO: move from thread by depth, or if equal, by localnodes at the time of pv change
 // TODO: perhaps don't search moves that has been searched by another thread to greater depth
 // TODO: changing tt date of used entries (thx Kestutis)
-// TODO: IID at cut nodes
 // TODO: continuation move
 // TODO: easy move code
 // TODO: no book moves in analyze mode
@@ -21,9 +21,109 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <cstring>
 #include <cmath>
 
-const int cEngine::razor_margin[5] = { 0, 300, 360, 420, 480 };
-const int cEngine::fut_margin[7] = { 0, 100, 160, 220, 280, 340, 400 };
-int cEngine::lmr_size[2][MAX_PLY][MAX_MOVES];
+#ifdef USE_THREADS
+    #include <mutex>
+    #include <condition_variable>
+#endif
+
+// pruning margins and limits indexed by [improving][depth]. Both rows hold
+// the old values; different ones for improving nodes need a game test first
+
+const int cEngine::razor_margin[2][5] = {
+    { 0, 300, 360, 420, 480 },
+    { 0, 300, 360, 420, 480 }
+};
+const int cEngine::fut_margin[2][7] = {
+    { 0, 100, 160, 220, 280, 340, 400 },
+    { 0, 100, 160, 220, 280, 340, 400 }
+};
+const int cEngine::lmp_limit[2][4] = {
+    { 0, 3, 6, 9 },
+    { 0, 3, 6, 9 }
+};
+
+// Natural logarithm usable at compile time: x = m * 2^k, 1 <= m < 2, and
+// ln(m) from the atanh series. Results match log() well enough to give the
+// same truncated reductions for every table entry.
+
+static constexpr double LnSeries(double y) { // ln((1 + y) / (1 - y))
+
+    double y2 = y * y, term = y, sum = 0.0;
+
+    for (int k = 1; k < 60; k += 2) {
+        sum += term / k;
+        term *= y2;
+    }
+    return 2.0 * sum;
+}
+
+static constexpr double Ln(int x) {
+
+    int k = 0;
+    double m = x;
+
+    while (m >= 2.0) {
+        m /= 2.0;
+        k++;
+    }
+    return k * LnSeries(1.0 / 3.0) + LnSeries((m - 1.0) / (m + 1.0));
+}
+
+static constexpr sLmrTable InitLmrTable() {
+
+    sLmrTable t = {};
+    double ln[64] = {};
+
+    for (int i = 1; i < 64; i++)
+        ln[i] = Ln(i);
+
+    // Set depth of late move reduction (formula based on Stockfish)
+
+    for (int dp = 0; dp < MAX_PLY; dp++)
+        for (int mv = 0; mv < 64; mv++) {
+
+            int r = 0;
+
+            if (dp != 0 && mv != 0) // +-inf to int is undefined
+                r = (int)(ln[dp] * ln[mv] / 2.0);
+
+            // same reductions whether static eval is improving or not,
+            // until a game test supports something else
+
+            for (int imp = 0; imp < 2; imp++) {
+
+                // zero window node, principal variation node (checking for pos. values is in `Search()`),
+                // reduction cannot exceed actual depth
+
+                t.size[0][imp][dp][mv] = (signed char)Min(r, dp - 1);
+                t.size[1][imp][dp][mv] = (signed char)Min(r - 1, dp - 1);
+            }
+        }
+
+    return t;
+}
+
+const sLmrTable cEngine::lmr = InitLmrTable(); // constant initialised, no startup cost
+
+// Lazy SMP: helper threads skip some iterations according to this schedule
+// (taken from Stockfish), so that at any time threads search different depths.
+// Thread n > 0 uses entry (n - 1) % SKIP_TABLE_SIZE.
+
+#define SKIP_TABLE_SIZE 20
+
+// minimal depth of a node whose children are marked as busy (ABDADA)
+
+#define ABDADA_DEPTH 4
+
+// Number of nodes before the first look at the clock. Later the interval
+// is set from the speed of the thread, so that the clock is read about
+// every TIME_CHECK_US microseconds.
+
+#define TIME_CHECK_START 256
+#define TIME_CHECK_US 250
+
+const int skip_size[SKIP_TABLE_SIZE]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+const int skip_phase[SKIP_TABLE_SIZE] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
 
 void cParam::InitAsymmetric(POS *p) {
 
@@ -54,48 +154,74 @@ void cGlobals::ClearData() {
     should_clear = false;
 }
 
-void cEngine::InitSearch() { // static init function
-
-    // Set depth of late move reduction (formula based on Stockfish)
-
-    for (int dp = 0; dp < MAX_PLY; dp++)
-        for (int mv = 0; mv < MAX_MOVES; mv++) {
-
-            int r = 0;
-
-            if (dp != 0 && mv != 0) // +-inf to int is undefined
-                r = (int)(log((double)dp) * log((double)Min(mv, 63)) / 2.0);
-
-            lmr_size[0][dp][mv] = r;     // zero window node
-            lmr_size[1][dp][mv] = r - 1; // principal variation node (checking for pos. values is in `Search()`)
-
-            // reduction cannot exceed actual depth
-            if (lmr_size[0][dp][mv] > dp - 1) lmr_size[0][dp][mv] = dp - 1;
-            if (lmr_size[1][dp][mv] > dp - 1) lmr_size[1][dp][mv] = dp - 1;
-        }
-}
-
 void cEngine::Think(POS *p) {
 
+#ifdef USE_COPY_MAKE
+    POS *curr = pos_stack;
+#else
     POS curr[1];
+#endif
     pv_eng[0] = 0; // clear engine's move
     pv_eng[1] = 0; // clear ponder move
+    score_eng = 0;
     fl_root_choice = false;
     *curr = *p;
+    memcpy(rep_list, Glob.rep_list, p->head * sizeof(U64));
+    memset(rep_filter, 0, sizeof(rep_filter));
+    for (int i = 0; i < p->head; i++)
+        rep_filter[RepIndex(rep_list[i])]++;
     AgeHist();
+
+    // Helper threads get slightly different move ordering, so that
+    // they don't follow the main thread into the same subtrees
+
+    rand_state = (thread_id + 1) * 0x9E3779B97F4A7C15ULL ^ tt_date;
+    if (thread_id > 0) PerturbHist();
+
     Iterate(curr, pv_eng);
 }
 
 void cEngine::Iterate(POS *p, int *pv) {
 
     int cur_val = 0;
+    int prev_val = -INF, prev_best = 0, stable_iterations = 0, iteration_start = 0; // -INF = no iteration yet
 
-    // Lazy SMP works best with some depth variance,
-    // so every other thread will search to depth + 1
+    // Root node is not reached by any move
+
+    SetNodeInfo(0, 0, -1, -1);
+    stack[0].pv[0] = 0;
+    local_nodes = 0;
+    time_check_cnt = TIME_CHECK_START;
+
+#ifdef USE_THREADS
+    TakeTurn(false); // root move list is ordered by the tt move
+#endif
 
-    int offset = thread_id & 0x01;
+    // Cannot report more lines than there are root moves
 
-    for (root_depth = 1 + offset; root_depth <= search_depth; root_depth++) {
+    InitRootMoves(p);
+    multi_pv = Max(1, Min(Glob.multi_pv, root_move_cnt));
+
+    for (int i = 0; i < multi_pv; i++) {
+        root_lines[i].score = 0;
+        root_lines[i].pv[0] = 0;
+    }
+
+    for (root_depth = 1; root_depth <= search_depth; root_depth++) {
+
+#ifdef USE_THREADS
+        if (root_depth > 1) TakeTurn(true);
+        if (Glob.abort_search) break;
+#endif
+
+        // Lazy SMP works best with some depth variance,
+        // so helper threads skip iterations on a schedule
+
+        if (thread_id > 0) {
+            int i = (thread_id - 1) % SKIP_TABLE_SIZE;
+            if (((root_depth + skip_phase[i]) / skip_size[i]) % 2)
+                continue;
+        }
 
         // If a thread is lagging behind too much, which makes it unlikely
         // to contribute to the final result, skip the iteration.
@@ -105,11 +231,52 @@ void cEngine::Iterate(POS *p, int *pv) {
             continue;
         }
 
-        // Perform actual earch
+        // Perform actual earch, once for each root line. Moves
+        // already chosen for the better lines are excluded.
 
         printf("info depth %d\n", root_depth);
-        if (Par.search_skill > 6) cur_val = Widen(p, root_depth, pv, cur_val);
-        else                      cur_val = Search(p, 0, -INF, INF, root_depth, 0, -1, -1, pv);
+        if (thread_id == 0) Glob.fail_low = false;
+        iteration_start = GetMS();
+
+        for (pv_idx = 0; pv_idx < multi_pv; pv_idx++) {
+
+            sRootLine *line = &root_lines[pv_idx];
+
+            // Root pv is updated only when a new best move is found,
+            // so it is valid even after an interrupted iteration,
+            // provided we start from the last known pv of this line
+
+            for (int i = 0; (stack[0].pv[i] = line->pv[i]); i++)
+                ;
+
+            if (Par.search_skill > 6) cur_val = Widen(p, root_depth, line->score);
+            else                      cur_val = Search(p, 0, -INF, INF, root_depth);
+
+            if (Glob.abort_search && pv_idx > 0) break;
+
+            // score of an interrupted search is meaningless, keep the old one
+
+            if (!Glob.abort_search) line->score = cur_val;
+            for (int i = 0; (line->pv[i] = stack[0].pv[i]); i++)
+                ;
+
+            if (Glob.abort_search) break;
+
+            // Keep lines ranked by score (a worse line may come
+            // back with a higher score due to search instability)
+
+            for (int i = pv_idx; i > 0 && root_lines[i].score > root_lines[i - 1].score; i--) {
+                sRootLine tmp = root_lines[i];
+                root_lines[i] = root_lines[i - 1];
+                root_lines[i - 1] = tmp;
+            }
+
+            if (multi_pv > 1) DisplayRootLines();
+        }
+
+        for (int i = 0; (pv[i] = root_lines[0].pv[i]); i++)
+            ;
+        cur_val = score_eng = root_lines[0].score;
         if (Glob.abort_search) break;
 
         // Shorten search if there is only one root move available
@@ -133,14 +300,96 @@ void cEngine::Iterate(POS *p, int *pv) {
         dp_completed = root_depth;
         if (Glob.depth_reached < dp_completed)
             Glob.depth_reached = dp_completed;
+
+        // Time management, done by the main thread: stop if another
+        // iteration is unlikely to finish or to change the best move
+
+        if (pv[0] == prev_best) stable_iterations++;
+        else                    stable_iterations = 0;
+
+        int score_drop = (prev_val == -INF) ? 0 : prev_val - cur_val;
+
+        if (thread_id == 0
+        && opt_time >= 0
+        && !Glob.pondering
+        && TimeToStop(GetMS() - start_time, GetMS() - iteration_start, stable_iterations, score_drop)) {
+            Glob.abort_search = true;
+            break;
+        }
+
+        prev_best = pv[0];
+        prev_val = cur_val;
     }
 
+#ifdef USE_THREADS
+    EndTurn();
+#endif
+
     if (!Par.shut_up) Glob.abort_search = true; // for correct exit from fixed depth search
 }
 
+#ifdef USE_THREADS
+
+// In deterministic mode threads search one root iteration at a time,
+// in a fixed order. Then the contents of the transposition table
+// (and thus node counts and the best move) do not depend on timing.
+
+static std::mutex turn_mutex;
+static std::condition_variable turn_cv;
+static int turn_threads = 0; // 0 = threads search freely
+static int turn_owner;
+static bool turn_done[MAX_THREADS];
+
+void StartTurns(int threads) {
+
+    std::lock_guard<std::mutex> lock(turn_mutex);
+    turn_threads = Glob.deterministic ? threads : 0;
+    turn_owner = 0;
+    for (int i = 0; i < MAX_THREADS; i++)
+        turn_done[i] = false;
+}
+
+void StopTurns() {
+
+    std::lock_guard<std::mutex> lock(turn_mutex);
+    turn_threads = 0;
+}
+
+static void PassTurn(int id) { // called with turn_mutex locked
+
+    for (int i = 1; i <= turn_threads; i++) {
+        int next = (id + i) % turn_threads;
+        if (!turn_done[next]) {
+            turn_owner = next;
+            break;
+        }
+    }
+    turn_cv.notify_all();
+}
+
+void cEngine::TakeTurn(bool has_turn) {
+
+    std::unique_lock<std::mutex> lock(turn_mutex);
+    if (!turn_threads) return;
+
+    if (has_turn) PassTurn(thread_id);
+    turn_cv.wait(lock, [this] { return turn_owner == thread_id; });
+}
+
+void cEngine::EndTurn() {
+
+    std::lock_guard<std::mutex> lock(turn_mutex);
+    if (!turn_threads) return;
+
+    turn_done[thread_id] = true;
+    if (turn_owner == thread_id) PassTurn(thread_id);
+}
+
+#endif
+
 // Aspiration search, progressively widening the window (based on Senpai 1.0)
 
-int cEngine::Widen(POS *p, int depth, int *pv, int lastScore) {
+int cEngine::Widen(POS *p, int depth, int lastScore) {
 
     int cur_val = lastScore, alpha, beta;
 
@@ -148,47 +397,79 @@ int cEngine::Widen(POS *p, int depth, int *pv, int lastScore) {
         for (int margin = 10; margin < 500; margin *= 2) {
             alpha = lastScore - margin;
             beta  = lastScore + margin;
-            cur_val = Search(p, 0, alpha, beta, depth, 0, -1, -1, pv);
+            cur_val = Search(p, 0, alpha, beta, depth);
             if (Glob.abort_search) break;
+
+            // best line failing low is a sign of trouble, give it more time
+
+            if (cur_val <= alpha && pv_idx == 0 && thread_id == 0)
+                Glob.fail_low = true;
+
             if (cur_val > alpha && cur_val < beta)
                 return cur_val;              // we have finished within the window
             if (cur_val > MAX_EVAL) break;   // verify mate searching with infinite bounds
         }
     }
 
-    cur_val = Search(p, 0, -INF, INF, depth, 0, -1, -1, pv); // full window search
+    cur_val = Search(p, 0, -INF, INF, depth); // full window search
     return cur_val;
 }
 
-int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, int was_null, int last_move, int last_capt_sq, int *pv) {
+int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth) {
 
-    int best, score, null_score, move, new_depth, new_pv[MAX_PLY];
+    int best, score, null_score, null_eval, move, new_depth;
     int mv_type, fl_check, reduction, victim, last_capt;
     int is_pv = (alpha != beta - 1);
     int null_refutation = -1, ref_sq = -1;
     int mv_tried = 0;
-    int mv_played[MAX_MOVES];
     int quiet_tried = 0;
     int fl_futility = 0;
     int mv_hist_score = 0;
-    MOVES m[1];
+    int tt_eval = -INF;
+    int root_idx = 0;
+    U64 root_nodes = 0;
+    sSearchStack *ss = &stack[ply];
+    int *pv = ss->pv;
+    int *new_pv = stack[ply + 1].pv;
+    MOVE *mv_played = ss->mv_played;
+    MOVES *m = &ss->m;
     UNDO u[1];
-    eData e;
 
     // QUIESCENCE SEARCH ENTRY POINT
 
-    if (depth <= 0) return QuiesceChecks(p, ply, alpha, beta, pv);
+    if (depth <= 0) return QuiesceChecks(p, ply, alpha, beta);
+
+    // Information how we got here, set by the caller
+
+    const int was_null = ss->was_null;
+    const int last_move = ss->last_move;
+    const int last_capt_sq = ss->last_capt_sq;
+    const int excluded_move = ss->excluded_move;
+
+    // Search result is incomplete if some moves are skipped, either
+    // by singular extension search or by MultiPV search at the root
+
+    const int fl_partial = excluded_move || (!ply && pv_idx > 0);
 
     // EARLY EXIT AND NODE INITIALIZATION
 
     Glob.nodes++;
-    //local_nodes++; unused
+    local_nodes++;
     Slowdown();
     if (Glob.abort_search && root_depth > 1) return 0;
     if (ply) *pv = 0;
+    rep_list[p->head] = p->hash_key;                // this position is on the search path now
     if (IsDraw(p) && ply) return DrawScore(p);
     move = 0;
 
+    // UPCOMING REPETITION
+    // (side to move can repeat a position, so it can score at least a draw)
+
+    if (ply && alpha < DrawScore(p) && UpcomingRepetition(p, ply)) {
+        alpha = DrawScore(p);
+        if (alpha >= beta) return alpha;
+    }
+
     // MATE DISTANCE PRUNING
 
     if (ply) {
@@ -209,7 +490,10 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, int was_nul
 
     // RETRIEVE MOVE FROM TRANSPOSITION TABLE
 
-    if (TransRetrieve(p->hash_key, &move, &score, alpha, beta, depth, ply)) {
+    // (unless this node searches for alternatives to the hash move)
+
+    if (!excluded_move
+    && TransRetrieve(p->hash_key, &move, &score, &tt_eval, alpha, beta, depth, ply)) {
         if (score >= beta) UpdateHistory(p, last_move, move, depth, ply);
         if (!is_pv && Par.search_skill > 0) return score;
     }
@@ -217,7 +501,7 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, int was_nul
     // SAFEGUARD AGAINST REACHING MAX PLY LIMIT
 
     if (ply >= MAX_PLY - 1) {
-        int eval = Evaluate(p, &e);
+        int eval = Evaluate(p, &e_data);
 #ifdef USE_RISKY_PARAMETER
         eval = EvalScaleByDepth(p, ply, eval);
 #endif
@@ -233,17 +517,28 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, int was_nul
                         && alpha > -MAX_EVAL
                         && beta < MAX_EVAL;
 
-    // GET EVAL SCORE IF NEEDED FOR PRUNING/REDUCTION DECISIONS
+    // GET EVAL SCORE FOR PRUNING/REDUCTION DECISIONS
+    // (reuse static eval from the transposition table if possible)
 
     int eval = 0;
-    if (fl_prunable_node
-    && (!was_null || depth <= 6)) {
-        eval = Evaluate(p, &e);
+    int raw_eval = -INF;
+    ss->eval = -INF;
+    if (!fl_check) {
+        if (tt_eval != -INF) raw_eval = eval = tt_eval;
+        else                 raw_eval = eval = Evaluate(p, &e_data);
 #ifdef USE_RISKY_PARAMETER
         eval = EvalScaleByDepth(p, ply, eval);
 #endif
+        ss->eval = eval;
     }
 
+    // IS STATIC EVAL BETTER THAN TWO PLIES AGO?
+    // (assume it is if we cannot tell)
+
+    int improving = (ply < 2
+                  || stack[ply - 2].eval == -INF
+                  || ss->eval >= stack[ply - 2].eval);
+
     // BETA PRUNING / STATIC NULL MOVE
 
     if (fl_prunable_node
@@ -259,6 +554,7 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, int was_nul
     if (depth > 1
     && Par.search_skill > 1
     && !was_null
+    && !excluded_move
     && fl_prunable_node
     && MayNull(p)
     && eval >= beta) {
@@ -271,21 +567,22 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, int was_nul
         // omit null move search if normal search to the same depth wouldn't exceed beta
         // (sometimes we can check it for free via hash table)
 
-        if (TransRetrieve(p->hash_key, &move, &null_score, alpha, beta, new_depth, ply)) {
+        if (TransRetrieve(p->hash_key, &move, &null_score, &tt_eval, alpha, beta, new_depth, ply)) {
             if (null_score < beta) goto avoid_null;
         }
 
-        p->DoNull(u);
-        if (new_depth <= 0) score = -QuiesceChecks(p, ply + 1, -beta, -beta + 1, new_pv);
-        else                score = -Search(p, ply + 1, -beta, -beta + 1, new_depth, 1, 0, -1, new_pv);
+        p = MakeNull(p, u);
+        SetNodeInfo(ply + 1, 1, 0, -1);
+        if (new_depth <= 0) score = -QuiesceChecks(p, ply + 1, -beta, -beta + 1);
+        else                score = -Search(p, ply + 1, -beta, -beta + 1, new_depth);
 
         // get location of a piece whose capture refuted null move
         // its escape will be prioritised in the move ordering
 
-        TransRetrieve(p->hash_key, &null_refutation, &null_score, alpha, beta, depth, ply);
+        TransRetrieve(p->hash_key, &null_refutation, &null_score, &null_eval, alpha, beta, depth, ply);
         if (null_refutation > 0) ref_sq = Tsq(null_refutation);
 
-        p->UndoNull(u);
+        p = UnmakeNull(p, u);
         if (Glob.abort_search && root_depth > 1) return 0;
 
         // do not return unproved mate scores, Stockfish-style
@@ -296,8 +593,11 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, int was_nul
 
             // verification search
 
-            if (new_depth > 6 && Par.search_skill > 9)
-                score = Search(p, ply, alpha, beta, new_depth - 5, 1, last_move, last_capt_sq, pv);
+            if (new_depth > 6 && Par.search_skill > 9) {
+                SetNodeInfo(ply, 1, last_move, last_capt_sq);
+                score = Search(p, ply, alpha, beta, new_depth - 5);
+                SetNodeInfo(ply, was_null, last_move, last_capt_sq);
+            }
 
             if (Glob.abort_search && root_depth > 1) return 0;
             if (score >= beta) return score;
@@ -312,12 +612,13 @@ avoid_null:
     && Par.search_skill > 3
     && !move
     && !was_null
+    && !excluded_move
     && !(p->Pawns(p->side) & bb_rel_rank[p->side][RANK_7]) // no pawns to promote in one move
     && depth <= 4) {
-        int threshold = beta - razor_margin[depth];
+        int threshold = beta - razor_margin[improving][depth];
 
         if (eval < threshold) {
-            score = QuiesceChecks(p, ply, alpha, beta, pv);
+            score = QuiesceChecks(p, ply, alpha, beta);
             if (score < threshold) return score;
         }
     } // end of razoring code
@@ -328,20 +629,74 @@ avoid_null:
     && !fl_check
     && !move
     && depth > 6) {
-        Search(p, ply, alpha, beta, depth - 2, 0, -1, last_capt_sq, pv);
+        SetNodeInfo(ply, 0, -1, last_capt_sq);
+        Search(p, ply, alpha, beta, depth - 2);
+        SetNodeInfo(ply, was_null, last_move, last_capt_sq);
         TransRetrieveMove(p->hash_key, &move);
     }
 
-    // TODO: internal iterative deepening in cut nodes
+    // INTERNAL ITERATIVE REDUCTION
+    // A zero window node without a hash move is likely to have poor move
+    // ordering. It is searched one ply shallower, and the hash move stored
+    // there will be available when the node is visited at full depth.
+
+    if (!is_pv
+    && !fl_check
+    && !move
+    && !excluded_move
+    && depth >= 6)
+        depth--;
+
+    // SINGULAR EXTENSION
+    // If a reduced depth search with the hash move excluded fails low
+    // well below the hash score, then the hash move is the only good
+    // one and deserves an extension.
+
+    int fl_singular = 0;
+
+    if (ply
+    && depth > 7
+    && Par.search_skill > 9
+    && move
+    && !excluded_move) {
+        int tt_score, tt_flags, tt_depth;
+
+        if (TransRetrieveEntry(p->hash_key, &tt_score, &tt_flags, &tt_depth, ply)
+        && (tt_flags & LOWER)
+        && tt_depth >= depth - 3
+        && Abs(tt_score) < MAX_EVAL) {
+            int sing_beta = tt_score - 3 * depth;
+
+            ss->excluded_move = move;
+            score = Search(p, ply, sing_beta - 1, sing_beta, depth / 2);
+            ss->excluded_move = 0;
+            *pv = 0;
+            if (Glob.abort_search && root_depth > 1) return 0;
+            if (score < sing_beta) fl_singular = 1;
+        }
+    }
 
     // PREPARE FOR MAIN SEARCH
 
     best = -INF;
-    InitMoves(p, m, move, Refutation(move), ref_sq, ply);
+    if (ply) InitMoves(p, m, move, Refutation(move), ref_sq, ply);
+    else     SortRootMoves();
+    ss->deferred_cnt = 0;
+    ss->deferred_next = -1;
+
+#ifdef USE_THREADS
+    // With more threads, mark positions being searched
+    // and let other threads defer them (ABDADA, if enabled)
+
+    int fl_busy = Glob.use_abdada && Glob.thread_no > 1 && !Glob.deterministic && depth >= ABDADA_DEPTH;
+#endif
 
     // MAIN LOOP
 
-    while ((move = NextMove(m, &mv_type))) {
+    while ((move = NextSearchMove(p, ply, &root_idx, &mv_type))) {
+
+        if (move == excluded_move) continue;
+        if (!ply && pv_idx > 0 && IsRootExcluded(move)) continue;
 
         // SET FUTILITY PRUNING FLAG
         // before the first applicable move is tried
@@ -351,7 +706,7 @@ avoid_null:
         && quiet_tried == 0
         && fl_prunable_node
         && depth <= 6) {
-           if (eval + fut_margin[depth] < beta) fl_futility = 1;
+           if (eval + fut_margin[improving][depth] < beta) fl_futility = 1;
         }
 
         // MAKE MOVE
@@ -360,8 +715,25 @@ avoid_null:
         victim = TpOnSq(p, Tsq(move));
         if (victim != NO_TP) last_capt = Tsq(move);
         else last_capt = -1;
-        p->DoMove(move, u);
-        if (Illegal(p)) { p->UndoMove(move, u); continue; }
+        if (!ply) root_nodes = local_nodes;
+        p = MakeMove(p, move, u);
+        if (Illegal(p)) { p = UnmakeMove(p, move, u); continue; }
+
+#ifdef USE_THREADS
+        // DEFER A MOVE SEARCHED BY ANOTHER THREAD
+        // (but never the first move, and not at the root, which has its own ordering)
+
+        if (fl_busy
+        && ply
+        && mv_tried > 0
+        && ss->deferred_next < 0
+        && IsBusy(p->hash_key)) {
+            p = UnmakeMove(p, move, u);
+            ss->deferred[ss->deferred_cnt] = move;
+            ss->deferred_flag[ss->deferred_cnt++] = mv_type;
+            continue;
+        }
+#endif
 
         // GATHER INFO ABOUT THE MOVE
 
@@ -393,6 +765,12 @@ avoid_null:
         && TpOnSq(p, Tsq(move)) == P
         && (SqBb(Tsq(move)) & (RANK_2_BB | RANK_7_BB))) new_depth += 1;
 
+        // 4. singular extension of the hash move, unless already extended
+
+        if (fl_singular
+        && mv_type == MV_HASH
+        && new_depth < depth) new_depth += 1;
+
         // FUTILITY PRUNING
 
         if (fl_futility
@@ -400,7 +778,7 @@ avoid_null:
         && mv_hist_score < Par.hist_limit
         && (mv_type == MV_NORMAL)
         &&  mv_tried > 1) {
-            p->UndoMove(move, u); continue;
+            p = UnmakeMove(p, move, u); continue;
         }
 
         // LATE MOVE PRUNING
@@ -408,11 +786,11 @@ avoid_null:
         if (fl_prunable_node
         && Par.search_skill > 5
         && depth < 4
-        && quiet_tried > 3 * depth
+        && quiet_tried > lmp_limit[improving][depth]
         && !InCheck(p)
         && mv_hist_score < Par.hist_limit
         && mv_type == MV_NORMAL) {
-            p->UndoMove(move, u); continue;
+            p = UnmakeMove(p, move, u); continue;
         }
 
         // LMR 1: NORMAL MOVES
@@ -424,11 +802,11 @@ avoid_null:
         && mv_tried > 3
         && !fl_check
         && !InCheck(p)
-        && lmr_size[is_pv][depth][mv_tried] > 0
+        && lmr.size[is_pv][improving][depth][Min(mv_tried, 63)] > 0
         && mv_type == MV_NORMAL
         && mv_hist_score < Par.hist_limit
         && MoveType(move) != CASTLE) {
-            reduction = (int)lmr_size[is_pv][depth][mv_tried];
+            reduction = (int)lmr.size[is_pv][improving][depth][Min(mv_tried, 63)];
 
             // increase reduction on bad history score
 
@@ -455,16 +833,21 @@ avoid_null:
             new_depth -= reduction;
         }
 
+        SetNodeInfo(ply + 1, 0, move, last_capt);
+#ifdef USE_THREADS
+        if (fl_busy) SetBusy(p->hash_key);
+#endif
+
 research:
 
         // PRINCIPAL VARIATION SEARCH
 
         if (best == -INF)
-            score = -Search(p, ply + 1, -beta, -alpha, new_depth, 0, move, last_capt, new_pv);
+            score = -Search(p, ply + 1, -beta, -alpha, new_depth);
         else {
-            score = -Search(p, ply + 1, -alpha - 1, -alpha, new_depth, 0, move, last_capt, new_pv);
+            score = -Search(p, ply + 1, -alpha - 1, -alpha, new_depth);
             if (!Glob.abort_search && score > alpha && score < beta)
-                score = -Search(p, ply + 1, -beta, -alpha, new_depth, 0, move, last_capt, new_pv);
+                score = -Search(p, ply + 1, -beta, -alpha, new_depth);
         }
 
         // DON'T REDUCE A MOVE THAT SCORED ABOVE ALPHA
@@ -475,11 +858,22 @@ research:
             goto research;
         }
 
+#ifdef USE_THREADS
+        if (fl_busy) ClearBusy(p->hash_key);
+#endif
+
         // UNDO MOVE
 
-        p->UndoMove(move, u);
+        p = UnmakeMove(p, move, u);
         if (Glob.abort_search && root_depth > 1) return 0;
 
+        // UPDATE ROOT MOVE STATISTICS FOR THE NEXT ITERATION
+
+        if (!ply) {
+            root_moves[root_idx - 1].score = (score > alpha) ? score : -INF;
+            root_moves[root_idx - 1].nodes = local_nodes - root_nodes;
+        }
+
         // BETA CUTOFF
 
         if (score >= beta) {
@@ -488,14 +882,19 @@ research:
                 for (int mv = 0; mv < mv_tried; mv++) {
                     DecreaseHistory(p, mv_played[mv], depth);
                 }
+                UpdateCaptHistory(p, move, depth);
+                for (int mv = 0; mv < mv_tried - 1; mv++) {
+                    DecreaseCaptHistory(p, mv_played[mv], depth);
+                }
             }
-            TransStore(p->hash_key, move, score, LOWER, depth, ply);
+            if (!fl_partial)
+                TransStore(p->hash_key, move, score, raw_eval, LOWER, depth, ply);
 
             // At root, change the best move and show the new pv
 
             if (!ply) {
                 BuildPv(pv, new_pv, move);
-                DisplayPv(score, pv);
+                if (multi_pv == 1) DisplayPv(0, score, pv);
             }
 
             return score;
@@ -508,7 +907,7 @@ research:
             if (score > alpha) {
                 alpha = score;
                 BuildPv(pv, new_pv, move);
-                if (!ply) DisplayPv(score, pv);
+                if (!ply && multi_pv == 1) DisplayPv(0, score, pv);
             }
         }
 
@@ -516,10 +915,15 @@ research:
 
     // RETURN CORRECT CHECKMATE/STALEMATE SCORE
 
-    if (best == -INF)
+    if (best == -INF) {
+        if (excluded_move) return alpha; // only the excluded move was legal
         return InCheck(p) ? -MATE + ply : DrawScore(p);
+    }
 
     // SAVE RESULT IN THE TRANSPOSITION TABLE
+    // (not if some moves were skipped, as the result is incomplete)
+
+    if (fl_partial) return best;
 
     if (*pv) {
         if (!fl_check) {
@@ -527,14 +931,29 @@ research:
             for (int mv = 0; mv < mv_tried; mv++) {
                 DecreaseHistory(p, mv_played[mv], depth);
             }
+            UpdateCaptHistory(p, *pv, depth);
+            for (int mv = 0; mv < mv_tried; mv++) {
+                if (mv_played[mv] != *pv)
+                    DecreaseCaptHistory(p, mv_played[mv], depth);
+            }
         }
-        TransStore(p->hash_key, *pv, best, EXACT, depth, ply);
+        TransStore(p->hash_key, *pv, best, raw_eval, EXACT, depth, ply);
     } else
-        TransStore(p->hash_key, 0, best, UPPER, depth, ply);
+        TransStore(p->hash_key, 0, best, raw_eval, UPPER, depth, ply);
 
     return best;
 }
 
+// Is the root move already chosen for one of the better lines?
+
+bool cEngine::IsRootExcluded(int move) {
+
+    for (int i = 0; i < pv_idx; i++)
+        if (root_lines[i].pv[0] == move) return true;
+
+    return false;
+}
+
 U64 GetNps(int elapsed) {
 
     U64 nps = 0;
@@ -551,7 +970,15 @@ void DisplayCurrmove(int move, int tried) {
     }
 }
 
-void cEngine::DisplayPv(int score, int *pv) {
+// Show all root lines found so far in MultiPV mode
+
+void cEngine::DisplayRootLines() {
+
+    for (int i = 0; i <= pv_idx; i++)
+        DisplayPv(i, root_lines[i].score, root_lines[i].pv);
+}
+
+void cEngine::DisplayPv(int line, int score, int *pv) {
 
     // don't display information from threads that are late
 
@@ -571,8 +998,11 @@ void cEngine::DisplayPv(int score, int *pv) {
 
     PvToStr(pv, pv_str);
 
-    printf("info depth %d time %d nodes %" PRIu64 " nps %" PRIu64 " score %s %d pv %s\n",
-           root_depth, elapsed, (U64)Glob.nodes, nps, type, score, pv_str);
+    char line_str[24] = "";
+    if (multi_pv > 1) sprintf(line_str, " multipv %d", line + 1);
+
+    printf("info depth %d%s time %d nodes %" PRIu64 " nps %" PRIu64 " score %s %d pv %s\n",
+           root_depth, line_str, elapsed, (U64)Glob.nodes, nps, type, score, pv_str);
 }
 
 void CheckTimeout() {
@@ -595,8 +1025,21 @@ void CheckTimeout() {
             Glob.pondering = false;
     }
 
-    if (!Glob.pondering && move_time >= 0 && GetMS() - start_time >= move_time)
-        Glob.abort_search = true;
+    CheckDeadline();
+}
+
+void CheckDeadline() {
+
+    if (!Glob.pondering && move_time >= 0) {
+        int elapsed = GetMS() - start_time;
+
+        // Stop at maximum time. Unless the root search has failed low, also
+        // stop an iteration that takes much longer than planned.
+
+        if (elapsed >= move_time
+        || (opt_time >= 0 && !Glob.fail_low && elapsed >= 2 * opt_time))
+            Glob.abort_search = true;
+    }
 }
 
 void cEngine::Slowdown() {
@@ -604,13 +1047,13 @@ void cEngine::Slowdown() {
     // Handling search limited by the number of nodes
 
     if (move_nodes > 0) {
-        if (Glob.nodes >= (unsigned)move_nodes)
+        if (Glob.nodes >= (unsigned)move_nodes && !Glob.pondering)
             Glob.abort_search = true;
     }
 
-    // Handling slowdown for weak levels
+    // Handling slowdown for weak levels (unless they have a node budget)
 
-    if (Par.nps_limit > 0) {
+    if (Par.nps_limit > 0 && !Glob.node_budget) {
         if (Par.nps_limit && root_depth > 1) {
             int time = GetMS() - start_time + 1;
             int nps = (int)GetNps(time);
@@ -626,14 +1069,24 @@ void cEngine::Slowdown() {
         }
     }
 
+    // Time control is enforced by each thread, but reading the clock
+    // on every node is too expensive, so it is done at node intervals
+
+    if (--time_check_cnt > 0) return;
+
+    int elapsed = GetMS() - start_time;
+    U64 interval = elapsed > 0 ? local_nodes * TIME_CHECK_US / (1000 * (U64)elapsed)
+                               : TIME_CHECK_START;
+    time_check_cnt = (int)Max(Min(interval, (U64)65536), (U64)16);
+
     // If Rodent is compiled as a single-threaded engine, Slowdown()
-    // function assumes additional role and it enforces time control
-    // handling.
+    // function assumes additional role and it also reads input.
+    // Otherwise the timer thread of ParseGo() does that.
 
 #ifndef USE_THREADS
-    if ( (!(Glob.nodes & 2047))
-    &&   !Glob.is_testing
-    &&   root_depth > 1) CheckTimeout();
+    if (!Glob.is_testing && root_depth > 1) CheckTimeout();
+#else
+    if (!Glob.is_tuning && root_depth > 1) CheckDeadline();
 #endif
 
 }
@@ -77,3 +77,73 @@ int Swap(POS *p, int from, int to) {
 
     return score[0];
 }
+
+// SeeGe() tells whether moving the piece on "from" to "to" wins at least
+// threshold in the exchange that follows. Unlike Swap() it stops as soon as
+// the outcome is known, and after each capture it looks again only along
+// the line (diagonal or straight) that the capturing piece could uncover.
+
+bool SeeGe(POS *p, int from, int to, int threshold) {
+
+    int side, type, res;
+    U64 attackers, occ, my_att, type_bb;
+
+    // even a free capture is not enough
+
+    int balance = tp_value[TpOnSq(p, to)] - threshold;
+    if (balance < 0) return false;
+
+    // losing the moved piece for nothing is still enough
+
+    type = TpOnSq(p, from);
+    balance = tp_value[type] - balance;
+    if (balance <= 0 && type != K) return true;
+
+    U64 bb_diag = p->tp_bb[B] | p->tp_bb[Q];
+    U64 bb_straight = p->tp_bb[R] | p->tp_bb[Q];
+    occ = OccBb(p) ^ SqBb(from);
+    attackers = (p->Pawns(WC) & BB.PawnAttacks(BC, to)) |
+                (p->Pawns(BC) & BB.PawnAttacks(WC, to)) |
+                (p->tp_bb[N] & BB.KnightAttacks(to)) |
+                (p->tp_bb[K] & BB.KingAttacks(to)) |
+                (bb_diag & BB.BishAttacks(occ, to)) |
+                (bb_straight & BB.RookAttacks(occ, to));
+
+    side = Cl(p->pc[from]);
+    if (type == K) return !(attackers & occ & p->cl_bb[Opp(side)]);
+    res = 1;
+
+    // res tells whether the side that made the last capture is still on course
+
+    for (;;) {
+        side ^= 1;
+        attackers &= occ;
+        my_att = attackers & p->cl_bb[side];
+        if (!my_att) break;
+
+        // find the weakest attacker
+
+        for (type = P; type <= K; type++)
+            if ((type_bb = my_att & p->tp_bb[type]))
+                break;
+
+        // king may capture only if nothing defends the square
+
+        if (type == K)
+            return (attackers & p->cl_bb[Opp(side)]) ? res : res ^ 1;
+
+        res ^= 1;
+        balance = tp_value[type] - balance;
+        if (balance < res) break;
+
+        // take it off and add x-ray attackers behind it
+
+        occ ^= type_bb & -type_bb;
+        if (type == P || type == B || type == Q)
+            attackers |= BB.BishAttacks(occ, to) & bb_diag;
+        if (type == R || type == Q)
+            attackers |= BB.RookAttacks(occ, to) & bb_straight;
+    }
+
+    return res;
+}
@@ -21,8 +21,11 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <cstdlib>
 #include <cstring>
 
-#if defined(USE_THREADS) && defined(NEW_THREADS)
+#ifdef USE_THREADS
     #include <atomic>
+#endif
+
+#if defined(USE_THREADS) && defined(NEW_THREADS)
     #include <memory>
 
     std::unique_ptr<std::atomic_flag[]> aflags0;
@@ -48,6 +51,8 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #endif
 
+#define TT_KEY(key) ((uint32_t)((key) >> 32))
+
 ChessHeapClass chc;
 
 void AllocTrans(unsigned int mbsize) {
@@ -97,7 +102,7 @@ void ClearTrans() {
     chc.ZeroMem();
 }
 
-bool TransRetrieve(U64 key, int *move, int *score, int alpha, int beta, int depth, int ply) {
+bool TransRetrieve(U64 key, int *move, int *score, int *eval, int alpha, int beta, int depth, int ply) {
 
     if (!chc.success) return false;
 
@@ -106,9 +111,10 @@ bool TransRetrieve(U64 key, int *move, int *score, int alpha, int beta, int dept
     LOCK_ME_PLEASE0;
 
     for (int i = 0; i < 4; i++) {
-        if (entry->key == key) {
+        if (entry->key == TT_KEY(key)) {
             entry->date = tt_date;
             *move = entry->move;
+            *eval = entry->eval;
             if (entry->depth >= depth) {
                 *score = entry->score;
                 if (*score < -MAX_EVAL)
@@ -141,7 +147,7 @@ void TransRetrieveMove(U64 key, int *move) {
     LOCK_ME_PLEASE1;
 
     for (int i = 0; i < 4; i++) {
-        if (entry->key == key) {
+        if (entry->key == TT_KEY(key)) {
             entry->date = tt_date; // TODO: test without this line (very low priority, long test)
             *move = entry->move;
             break;
@@ -152,7 +158,37 @@ void TransRetrieveMove(U64 key, int *move) {
     UNLOCK_ME_PLEASE1;
 }
 
-void TransStore(U64 key, int move, int score, int flags, int depth, int ply) {
+// Used by singular extension, which needs to know not only
+// the score of a hash entry, but also its bound and depth
+
+bool TransRetrieveEntry(U64 key, int *score, int *flags, int *depth, int ply) {
+
+    if (!chc.success) return false;
+
+    ENTRY *entry = chc[key & tt_mask];
+
+    LOCK_ME_PLEASE1;
+
+    for (int i = 0; i < 4; i++) {
+        if (entry->key == TT_KEY(key)) {
+            *score = entry->score;
+            if (*score < -MAX_EVAL)
+                *score += ply;
+            else if (*score > MAX_EVAL)
+                *score -= ply;
+            *flags = entry->flags;
+            *depth = entry->depth;
+            UNLOCK_ME_PLEASE1;
+            return true;
+        }
+        entry++;
+    }
+
+    UNLOCK_ME_PLEASE1;
+    return false;
+}
+
+void TransStore(U64 key, int move, int score, int eval, int flags, int depth, int ply) {
 
     if (!chc.success) return;
 
@@ -166,8 +202,9 @@ void TransStore(U64 key, int move, int score, int flags, int depth, int ply) {
     ENTRY *entry = chc[key & tt_mask], *replace = NULL;
 
     for (int i = 0; i < 4; i++) {
-        if (entry->key == key) {
+        if (entry->key == TT_KEY(key)) {
             if (!move) move = entry->move;
+            if (eval == -INF) eval = entry->eval;
             replace = entry;
             break;
         }
@@ -181,9 +218,38 @@ void TransStore(U64 key, int move, int score, int flags, int depth, int ply) {
 
     LOCK_ME_PLEASE01;
 
-    replace->key = key; replace->date = tt_date; replace->move = move;
-    replace->score = score; replace->flags = flags; replace->depth = depth;
+    replace->key = TT_KEY(key); replace->date = tt_date; replace->move = move;
+    replace->score = score; replace->eval = eval; replace->flags = flags; replace->depth = depth;
 
     UNLOCK_ME_PLEASE0;
     UNLOCK_ME_PLEASE1;
 }
+
+#ifdef USE_THREADS
+
+// ABDADA-style table of positions that some thread is searching right now.
+// It is lockless: a lost or stale entry costs a bit of efficiency, never
+// correctness, so relaxed atomics are enough.
+
+#define BUSY_SIZE (1 << 15)
+
+std::atomic<U64> busy_table[BUSY_SIZE];
+
+bool IsBusy(U64 key) {
+
+    return busy_table[key & (BUSY_SIZE - 1)].load(std::memory_order_relaxed) == key;
+}
+
+void SetBusy(U64 key) {
+
+    busy_table[key & (BUSY_SIZE - 1)].store(key, std::memory_order_relaxed);
+}
+
+void ClearBusy(U64 key) {
+
+    // don't clear a slot already taken over by another position
+
+    busy_table[key & (BUSY_SIZE - 1)].compare_exchange_strong(key, 0, std::memory_order_relaxed);
+}
+
+#endif
@@ -20,6 +20,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <climits>
 
 #ifdef USE_THREADS
     #include <thread>
@@ -109,6 +110,27 @@ void UciLoop() {
 #else
             Engines.front().Bench(atoi(token));
 #endif
+#ifdef USE_THREADS
+        } else if (strcmp(token, "smpbench") == 0)   {
+            char token2[80];
+            ptr = ParseToken(ptr, token);
+            ParseToken(ptr, token2);
+            SmpBench(atoi(token), atoi(token2));
+#endif
+        } else if (strcmp(token, "perft") == 0)      {
+            ptr = ParseToken(ptr, token);
+            int depth = Max(atoi(token), 1);
+            int start = GetMS();
+            U64 nodes = Perft(p, depth);
+            printf("perft %d: %" PRIu64 " nodes in %d ms\n", depth, nodes, GetMS() - start);
+        } else if (strcmp(token, "startup") == 0)    {
+            PrintStartupTimes();
+        } else if (strcmp(token, "sliderbench") == 0) {
+            ptr = ParseToken(ptr, token);
+            SliderBench(atoi(token));
+        } else if (strcmp(token, "seebench") == 0)   {
+            ptr = ParseToken(ptr, token);
+            SeeBench(atoi(token));
         } else if (strcmp(token, "quit") == 0)       {
             exit(0);
         }
@@ -132,6 +154,7 @@ void ParseMoves(POS *p, const char *ptr) {
 
         const int move = StrToMove(p, token);
         if (Legal(p, move)) {
+            Glob.rep_list[p->head] = p->hash_key;
             p->DoMove(move, u);
             Glob.moves_from_start++;
         }
@@ -139,7 +162,7 @@ void ParseMoves(POS *p, const char *ptr) {
 
         // We won't be taking back moves beyond this point:
 
-        if (p->rev_moves == 0) p->head = 0;
+        if (p->rev_moves == 0 || p->head >= REP_LIST_SIZE) p->head = 0;
     }
 }
 
@@ -166,6 +189,15 @@ void ParsePosition(POS *p, const char *ptr) {
         ParseMoves(p, ptr);
 }
 
+bool IsMoveStr(const char *str) {
+
+    int len = strlen(str);
+
+    return (len == 4 || len == 5)
+        && str[0] >= 'a' && str[0] <= 'h' && str[1] >= '1' && str[1] <= '8'
+        && str[2] >= 'a' && str[2] <= 'h' && str[3] >= '1' && str[3] <= '8';
+}
+
 int BulletCorrection(int time) {
 
     if (time < 200)       return (time * 23) / 32;
@@ -190,33 +222,71 @@ void SetMoveTime(int base, int inc, int movestogo) {
 
     if (base >= 0) {
         if (movestogo == 1) base -= Min(1000, base / 10);
-        move_time = (base + inc * (movestogo - 1)) / movestogo;
+        opt_time = (base + inc * (movestogo - 1)) / movestogo;
 
         // make a percentage correction to playing speed (unless too risky)
 
-        if (2 * move_time > base) {
-            move_time *= Par.time_percentage;
-            move_time /= 100;
+        if (2 * opt_time > base) {
+            opt_time *= Par.time_percentage;
+            opt_time /= 100;
         }
 
-        // ensure that our limit does not exceed total time available
+        // maximum time can be used if search is in trouble, but it leaves
+        // enough time for the next moves (none left before time control)
+
+        if (movestogo == 1) move_time = opt_time;
+        else                move_time = Max(opt_time, Min(5 * opt_time, base / 4));
 
+        // ensure that our limits do not exceed total time available
+
+        if (opt_time > base) opt_time = base;
         if (move_time > base) move_time = base;
 
         // safeguard against a lag
 
+        opt_time -= 10;
         move_time -= 10;
 
         // ensure that we have non-negative time
 
+        if (opt_time < 0) opt_time = 0;
         if (move_time < 0) move_time = 0;
 
         // assign less time per move on extremely short time controls
 
+        opt_time = BulletCorrection(opt_time);
         move_time = BulletCorrection(move_time);
     }
 }
 
+// Called after each completed iteration. Decides whether to stop, given
+// how long we have been thinking, how long the last iteration took, for how
+// many iterations the best move stayed the same and how much the score fell.
+
+bool TimeToStop(int elapsed, int iteration_time, int stable_iterations, int score_drop) {
+
+    int percentage = 100;
+
+    // spend more time if the best move has just changed, less if it is stable
+
+    if (stable_iterations == 0)      percentage += 30;
+    else if (stable_iterations >= 6) percentage -= 50;
+    else if (stable_iterations >= 3) percentage -= 25;
+
+    // spend more time if the score drops
+
+    if (score_drop > 0) percentage += Min(score_drop, 60);
+
+    if (elapsed >= opt_time * percentage / 100) return true;
+
+    // don't start an iteration that is unlikely to finish
+    // (next one is expected to take twice as long as the last)
+
+    if (elapsed + 2 * iteration_time > Min(move_time, 2 * opt_time)) return true;
+
+    return false;
+}
+
 void ParseGo(POS *p, const char *ptr) {
 
     char token[80];
@@ -224,7 +294,9 @@ void ParseGo(POS *p, const char *ptr) {
     int pvb;
 
     move_time = -1;
+    opt_time = -1;
     move_nodes = 0;
+    Glob.node_budget = false;
     Glob.pondering = false;
     wtime = -1;
     btime = -1;
@@ -234,6 +306,8 @@ void ParseGo(POS *p, const char *ptr) {
     strict_time = false;
     search_depth = 64;
     Par.shut_up = false;
+    Glob.search_moves_cnt = 0;
+    bool reading_moves = false;
 
     for (;;) {
         ptr = ParseToken(ptr, token);
@@ -269,7 +343,16 @@ void ParseGo(POS *p, const char *ptr) {
         } else if (strcmp(token, "movestogo") == 0) {
             ptr = ParseToken(ptr, token);
             movestogo = atoi(token);
+        } else if (strcmp(token, "searchmoves") == 0) {
+            reading_moves = true;
+            continue;
+        } else if (reading_moves && IsMoveStr(token)) {
+            int move = StrToMove(p, token);
+            if (Legal(p, move) && Glob.search_moves_cnt < MAX_MOVES)
+                Glob.search_moves[Glob.search_moves_cnt++] = move;
+            continue;
         }
+        reading_moves = false; // any other token ends the list of moves
     }
 
     // set move time
@@ -280,12 +363,30 @@ void ParseGo(POS *p, const char *ptr) {
         SetMoveTime(base, inc, movestogo);
     }
 
+    // Weak levels may get a node budget instead of being slowed down: we search
+    // as many nodes as a machine running at Par.nps_limit would search in the
+    // planned time. This doesn't depend on hardware or load and needs no waiting.
+    // Without a planned time (infinite or fixed depth search) Slowdown() waits.
+
+    if (Par.nps_limit > 0 && Par.nps_by_nodes) {
+        int budget_time = opt_time >= 0 ? opt_time : move_time;
+
+        if (budget_time >= 0) {
+            U64 budget = (U64)Par.nps_limit * budget_time / 1000;
+            budget = Max(budget, (U64)1);
+            if (move_nodes <= 0 || budget < (U64)move_nodes)
+                move_nodes = (int)Min(budget, (U64)INT_MAX);
+            Glob.node_budget = true;
+        }
+    }
+
     // set global variables
 
     start_time = GetMS();
     tt_date = (tt_date + 1) & 255;
     Glob.nodes = 0;
     Glob.abort_search = false;
+    Glob.fail_low = false;
     Glob.depth_reached = 0;
     if (Glob.should_clear)
         Glob.ClearData(); // options has been changed and old tt scores are no longer reliable
@@ -316,96 +417,290 @@ void ParseGo(POS *p, const char *ptr) {
 #else
     Glob.goodbye = false;
 
+    StartTurns(Glob.thread_no);
     for (auto& engine: Engines) // dp_completed cleared in StartThinkThread();
         engine.StartThinkThread(p);
 
     std::thread timer([] {
         while (Glob.abort_search == false) {
 
-            // Check for timeut every 5 miliseconds. This allows Rodent
-            // to survive extreme time controls, like 1 s + 10 ms
+            // Check for input and timeout every milisecond. Search threads
+            // watch the clock themselves, but the move is sent only after
+            // this thread notices the end of search.
 
-            std::this_thread::sleep_for(5ms);
+            std::this_thread::sleep_for(1ms);
             if (!Glob.is_tuning) CheckTimeout();
         }
     });
 
     for (auto& engine: Engines)
         engine.WaitThinkThread();
+    StopTurns();
 
     timer.join();
 
     if (Glob.goodbye)
         exit(0);
 
-    int *best_pv, best_depth = -1;
+    // Choose the move by thread voting. Each thread votes for its best move,
+    // with weight growing with its score (relative to the lowest one)
+    // and with completed depth. Threads that have not completed any
+    // iteration get no vote.
+
+    int min_score = INF;
 
     for (auto& engine: Engines)
-        if (best_depth < engine.dp_completed) {
-            best_depth = engine.dp_completed;
-            best_pv = engine.pv_eng;
+        if (engine.dp_completed > 0)
+            min_score = Min(min_score, engine.score_eng);
+
+    int moves[MAX_THREADS], votes[MAX_THREADS], n_moves = 0;
+    cEngine *best_engine = &Engines.front();
+    int best_votes = -1;
+
+    for (auto& engine: Engines) {
+        if (engine.dp_completed == 0 || !engine.pv_eng[0]) continue;
+
+        int weight = (engine.score_eng - min_score + 14) * engine.dp_completed;
+        int i = 0;
+        while (i < n_moves && moves[i] != engine.pv_eng[0]) i++;
+        if (i == n_moves) {
+            moves[n_moves] = engine.pv_eng[0];
+            votes[n_moves++] = 0;
         }
+        votes[i] += weight;
+    }
+
+    // Among threads playing the most supported move, take the
+    // deepest one, as its pv is the most reliable ponder source
 
-    ExtractMove(best_pv);
+    for (auto& engine: Engines) {
+        if (engine.dp_completed == 0 || !engine.pv_eng[0]) continue;
+
+        int i = 0;
+        while (moves[i] != engine.pv_eng[0]) i++;
+        if (votes[i] > best_votes
+        || (votes[i] == best_votes && engine.dp_completed > best_engine->dp_completed)) {
+            best_votes = votes[i];
+            best_engine = &engine;
+        }
+    }
+
+    ExtractMove(best_engine->pv_eng);
 #endif
 
 }
 
+const char *bench_test[] = {
+    "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq -",       // 1.e4 c5 2.Nf3 Nc6
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",   // multiple captures
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",                              // rook endgame
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",      // knight pseudo-sack
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",  // pawn chain
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",     // attack for pawn
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",        // exchange sack
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",  // white pawn center
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",         // endgame
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",        // both queens en prise
+    NULL
+}; // test positions taken from DiscoCheck by Lucas Braesch
+
 void cEngine::Bench(int depth) {
 
     POS p[1];
     int pv[MAX_PLY];
-    const char *test[] = {
-        "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq -",       // 1.e4 c5 2.Nf3 Nc6
-        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",   // multiple captures
-        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",                              // rook endgame
-        "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
-        "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",      // knight pseudo-sack
-        "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",  // pawn chain
-        "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
-        "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
-        "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",     // attack for pawn
-        "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",        // exchange sack
-        "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
-        "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",  // white pawn center
-        "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
-        "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
-        "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",         // endgame
-        "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",        // both queens en prise
-        NULL
-    }; // test positions taken from DiscoCheck by Lucas Braesch
 
     if (depth == 0) depth = 8; // so that you can call bench without parameters
-    ClearTrans();
-    ClearAll();
-    dp_completed = 0; // maybe move to ClearAll()?
     Par.shut_up = true;
+    Glob.search_moves_cnt = 0;
+    move_time = -1; // no time management
+    opt_time = -1;
+    move_nodes = 0; // nor a node budget left over from the last "go"
+    Glob.node_budget = false;
 
     printf("Bench test started (depth %d): \n", depth);
 
-    Glob.nodes = 0;
-    Glob.abort_search = false;
-    start_time = GetMS();
-    search_depth = depth;
+    auto run_suite = [&]() {
+
+        ClearTrans();
+        ClearAll();
+        dp_completed = 0; // maybe move to ClearAll()?
 
-    // search each position to desired depth
+        Glob.nodes = 0;
+        Glob.abort_search = false;
+        start_time = GetMS();
+        search_depth = depth;
 
-    for (int i = 0; test[i]; ++i) {
-        printf("%s\n", test[i]);
-        SetPosition(p, test[i]);
-        Par.InitAsymmetric(p);
-        Glob.depth_reached = 0;
-        Iterate(p, pv);
+        // search each position to desired depth
+
+        for (int i = 0; bench_test[i]; ++i) {
+            printf("%s\n", bench_test[i]);
+            SetPosition(p, bench_test[i]);
+            Par.InitAsymmetric(p);
+            Glob.depth_reached = 0;
+            Iterate(p, pv);
+        }
+
+        return GetMS() - start_time;
+    };
+
+    // In MultiPV mode search single line first,
+    // so that we can report time-to-depth overhead
+
+    int lines = Glob.multi_pv;
+    int single_time = 0;
+    U64 single_nodes = 0;
+
+    if (lines > 1) {
+        Glob.multi_pv = 1;
+        single_time = run_suite();
+        single_nodes = Glob.nodes;
+        Glob.multi_pv = lines;
     }
 
+    int end_time = run_suite();
+
     // calculate and print statistics
 
-    int end_time = GetMS() - start_time;
     unsigned int nps = (unsigned int)((Glob.nodes * 1000) / (end_time + 1));
 
+    if (lines > 1) {
+        printf("multipv 1: %" PRIu64 " nodes searched in %d\n", single_nodes, single_time);
+        printf("multipv %d: time-to-depth overhead %.2fx time, %.2fx nodes\n", lines,
+               (double)(end_time + 1) / (single_time + 1), (double)Glob.nodes / (single_nodes + 1));
+    }
+
     printf("%" PRIu64 " nodes searched in %d, speed %u nps (Score: %.3f)\n", (U64)Glob.nodes, end_time, nps, (float)nps / 430914.0);
 }
 
+#ifdef USE_THREADS
+
+// Time-to-depth on bench positions using 1..max_threads threads. Every
+// position is searched like "go depth", i.e. until any thread completes
+// the requested depth, so speedup is measured in the way it matters.
+
+void SmpBench(int depth, int max_threads) {
+
+    POS p[1];
+    int single_time = 0;
+    int saved_threads = Glob.thread_no;
+
+    if (depth == 0) depth = 10;
+    if (max_threads <= 0 || max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    move_time = -1;
+    opt_time = -1;
+    move_nodes = 0;
+    Glob.node_budget = false;
+    search_depth = depth;
+    Glob.pondering = false;
+    Glob.search_moves_cnt = 0;
+    Par.shut_up = false; // first thread to complete the depth stops the others
+
+    printf("SMP bench started (depth %d, 1..%d threads): \n", depth, max_threads);
+
+    for (int threads = 1; threads <= max_threads; threads++) {
+
+        Engines.clear();
+        for (int i = 0; i < threads; i++)
+            Engines.emplace_back(i);
+        ClearTrans();
+        Glob.thread_no = threads;
+
+        Glob.nodes = 0;
+        int bench_start = GetMS();
+
+        for (int i = 0; bench_test[i]; ++i) {
+            SetPosition(p, bench_test[i]);
+            Par.InitAsymmetric(p);
+            start_time = GetMS();
+            tt_date = (tt_date + 1) & 255;
+            Glob.abort_search = false;
+            Glob.depth_reached = 0;
+
+            StartTurns(threads);
+            for (auto& engine: Engines)
+                engine.StartThinkThread(p);
+            for (auto& engine: Engines)
+                engine.WaitThinkThread();
+            StopTurns();
+        }
+
+        int elapsed = GetMS() - bench_start;
+        if (threads == 1) single_time = elapsed;
+        unsigned int nps = (unsigned int)((Glob.nodes * 1000) / (elapsed + 1));
+
+        printf("threads %d: %" PRIu64 " nodes in %d ms, %u nps, time-to-depth speedup %.2f\n",
+               threads, (U64)Glob.nodes, elapsed, nps, (double)(single_time + 1) / (elapsed + 1));
+    }
+
+    // restore the number of threads set by the user
+
+    Glob.thread_no = saved_threads;
+    Engines.clear();
+    for (int i = 0; i < Glob.thread_no; i++)
+        Engines.emplace_back(i);
+}
+
+#endif
+
+// Speed of static exchange evaluation on all moves of the bench positions,
+// full Swap() score against the threshold-only SeeGe()
+
+void SeeBench(int iterations) {
+
+    const int thresholds[4] = { -300, 0, 1, 200 };
+    const int max_moves = 2048;
+    static POS pos[32];
+    static int pos_idx[max_moves], moves[max_moves];
+    int move_cnt = 0, mismatches = 0, swap_sum = 0, see_sum = 0;
+
+    if (iterations <= 0) iterations = 1000;
+
+    for (int i = 0; bench_test[i]; ++i) {
+        int list[256], *end;
+        SetPosition(&pos[i], bench_test[i]);
+        end = GenerateCaptures(&pos[i], list);
+        end = GenerateQuiet(&pos[i], end);
+        for (int *mv = list; mv < end && move_cnt < max_moves; mv++) {
+            pos_idx[move_cnt] = i;
+            moves[move_cnt++] = *mv & 0xffff;
+        }
+    }
+
+    // both must agree before their speed is worth comparing
+
+    for (int i = 0; i < move_cnt; i++)
+        for (int t = 0; t < 4; t++) {
+            POS *p = &pos[pos_idx[i]];
+            int fsq = Fsq(moves[i]), tsq = Tsq(moves[i]);
+            if ((Swap(p, fsq, tsq) >= thresholds[t]) != SeeGe(p, fsq, tsq, thresholds[t]))
+                mismatches++;
+        }
+
+    int start = GetMS();
+    for (int it = 0; it < iterations; it++)
+        for (int i = 0; i < move_cnt; i++)
+            swap_sum += Swap(&pos[pos_idx[i]], Fsq(moves[i]), Tsq(moves[i])) >= 0;
+    int swap_time = GetMS() - start;
+
+    start = GetMS();
+    for (int it = 0; it < iterations; it++)
+        for (int i = 0; i < move_cnt; i++)
+            see_sum += SeeGe(&pos[pos_idx[i]], Fsq(moves[i]), Tsq(moves[i]), 0);
+    int see_time = GetMS() - start;
+
+    U64 calls = (U64)iterations * move_cnt;
+    printf("%d moves, %d mismatches, %d vs %d non-losing\n", move_cnt, mismatches, swap_sum, see_sum);
+    printf("Swap():  %" PRIu64 " calls in %d ms, %.1f M/s\n", calls, swap_time, (double)calls / ((swap_time + 1) * 1000.0));
+    printf("SeeGe(): %" PRIu64 " calls in %d ms, %.1f M/s\n", calls, see_time, (double)calls / ((see_time + 1) * 1000.0));
+}
+
 void PrintBoard(POS *p) {
 
     const char *piece_name[] = { "P ", "p ", "N ", "n ", "B ", "b ", "R ", "r ", "Q ", "q ", "K ", "k ", ". " };
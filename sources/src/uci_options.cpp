@@ -29,7 +29,10 @@ void PrintUciOptions() {
     printf("option name Hash type spin default 16 min 1 max 4096\n");
 #ifdef USE_THREADS
     printf("option name Threads type spin default %d min 1 max %d\n", Glob.thread_no, MAX_THREADS);
+    printf("option name Deterministic type check default %s\n", Glob.deterministic ? "true" : "false");
+    printf("option name ABDADA type check default %s\n", Glob.use_abdada ? "true" : "false");
 #endif
+    printf("option name MultiPV type spin default 1 min 1 max %d\n", MAX_MULTIPV);
     printf("option name Clear Hash type button\n");
 
     if (Glob.use_personality_files) {
@@ -80,6 +83,8 @@ void PrintUciOptions() {
 
         printf("option name Contempt type spin default %d min -500 max 500\n", Par.draw_score);
 
+        printf("option name NodeBudgetWeakening type check default %s\n", Par.nps_by_nodes ? "true" : "false");
+
         if (!Glob.elo_slider) {
             printf("option name EvalBlur type spin default %d min 0 max 5000000\n", Par.eval_blur);
             printf("option name NpsLimit type spin default %d min 0 max 5000000\n", Par.nps_limit);
@@ -155,7 +160,15 @@ void ParseSetoption(const char *ptr) {
             for (int i = 0; i < Glob.thread_no; i++)
                 Engines.emplace_back(i);
         }
+    } else if (strcmp(name, "deterministic") == 0)                           {
+        valuebool(Glob.deterministic, value);
+    } else if (strcmp(name, "abdada") == 0)                                  {
+        valuebool(Glob.use_abdada, value);
 #endif
+    } else if (strcmp(name, "multipv") == 0)                                 {
+        Glob.multi_pv = atoi(value);
+        if (Glob.multi_pv < 1) Glob.multi_pv = 1;
+        if (Glob.multi_pv > MAX_MULTIPV) Glob.multi_pv = MAX_MULTIPV;
     } else if (strcmp(name, "clear hash") == 0)                              {
         ClearTrans();
     } else if (strcmp(name, "pawnvaluemg") == 0)                             {
@@ -514,6 +527,8 @@ void ParseSetoption(const char *ptr) {
         Glob.should_clear = true;
     } else if (strcmp(name, "npslimit") == 0)                                {
         Par.nps_limit = atoi(value);
+    } else if (strcmp(name, "nodebudgetweakening") == 0)                     {
+        valuebool(Par.nps_by_nodes, value);
     } else if (strcmp(name, "uci_elo") == 0)                                 {
         Par.elo = atoi(value);
         Par.SetSpeed(Par.elo);
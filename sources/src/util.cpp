@@ -23,6 +23,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #else
     #include <unistd.h>
     #include <sys/time.h>
+    #include <time.h>
 #endif
 
 #include "rodent.h"
@@ -76,19 +77,15 @@ int GetMS() {
 #if defined(_WIN32) || defined(_WIN64)
     return GetTickCount();
 #else
-    struct timeval tv;
-
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
-#endif
-}
-
-U64 Random64() {
+    // monotonic clock doesn't jump when system time is adjusted, and
+    // is read without a system call (CLOCK_MONOTONIC_COARSE would be
+    // cheaper still, but its resolution of a timer tick is too low)
 
-    static U64 next = 1;
+    struct timespec ts;
 
-    next = next * 1103515245 + 12345;
-    return next;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
 }
 
 void POS::InitHashKey() {
@@ -97,11 +94,11 @@ void POS::InitHashKey() {
 
     for (int i = 0; i < 64; i++)
         if (pc[i] != NO_PC)
-            key ^= zob_piece[pc[i]][i];
+            key ^= zob.piece[pc[i]][i];
 
-    key ^= zob_castle[c_flags];
+    key ^= zob.castle[c_flags];
     if (ep_sq != NO_SQ)
-        key ^= zob_ep[File(ep_sq)];
+        key ^= zob.ep[File(ep_sq)];
 
     if (side == BC)
         key ^= SIDE_RANDOM;
@@ -115,7 +112,7 @@ void POS::InitPawnKey() {
 
     for (int i = 0; i < 64; i++) {
         if ((tp_bb[P] & SqBb(i)) || (tp_bb[K] & SqBb(i)))
-            key ^= zob_piece[pc[i]][i];
+            key ^= zob.piece[pc[i]][i];
     }
 
     pawn_key = key;